@@ -0,0 +1,49 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ALLOCATION_STATS_HPP__
+#define __ALLOCATION_STATS_HPP__
+
+#include <cstdint>
+
+// Number of heap allocations the calling thread has made so far. Debug
+// builds replace the global operator new to count them; release builds
+// always return 0.
+extern std::uint64_t thread_allocations();
+
+// Adds the allocations made on this thread during its lifetime to *total.
+class allocation_scope
+{
+public:
+    explicit allocation_scope(std::uint64_t *total)
+        : total_(total)
+        , start_(thread_allocations())
+    {
+    }
+    ~allocation_scope()
+    {
+        *total_ += thread_allocations() - start_;
+    }
+    allocation_scope(allocation_scope const &) = delete;
+    allocation_scope &operator=(allocation_scope const &) = delete;
+
+private:
+    std::uint64_t *total_;
+    std::uint64_t start_;
+};
+
+#endif // __ALLOCATION_STATS_HPP__
@@ -0,0 +1,72 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bloom_filter.hpp"
+#include "helper.hpp"
+
+namespace
+{
+    // Two independent-enough hashes for double hashing (Kirsch and
+    // Mitzenmacher): the k probes are h1 + i * h2.
+    void hash_pair(std::string_view key, std::uint64_t &h1, std::uint64_t &h2)
+    {
+        h1 = fnv1a_hash(key);
+        std::uint64_t h = h1;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h2 = (h ^ (h >> 31)) | 1;
+    }
+}
+
+bloom_filter::bloom_filter(std::size_t expected_keys, double false_positive_rate)
+{
+    double const ln2 = std::log(2.0);
+    double const n = static_cast<double>(std::max<std::size_t>(expected_keys, 1));
+    double const p = std::clamp(false_positive_rate, 1e-9, 0.5);
+    num_bits_ = std::max<std::uint64_t>(64, static_cast<std::uint64_t>(std::ceil(-n * std::log(p) / (ln2 * ln2))));
+    num_hashes_ = std::clamp(static_cast<unsigned int>(std::lround(static_cast<double>(num_bits_) / n * ln2)), 1U, 16U);
+    bits_.assign((num_bits_ + 63) / 64, 0);
+}
+
+void bloom_filter::add(std::string_view key)
+{
+    std::uint64_t h1, h2;
+    hash_pair(key, h1, h2);
+    for (unsigned int i = 0; i < num_hashes_; ++i)
+    {
+        std::uint64_t const bit = (h1 + i * h2) % num_bits_;
+        bits_[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool bloom_filter::maybe_contains(std::string_view key) const
+{
+    std::uint64_t h1, h2;
+    hash_pair(key, h1, h2);
+    for (unsigned int i = 0; i < num_hashes_; ++i)
+    {
+        std::uint64_t const bit = (h1 + i * h2) % num_bits_;
+        if ((bits_[bit / 64] & (1ULL << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
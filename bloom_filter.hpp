@@ -0,0 +1,44 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BLOOM_FILTER_HPP__
+#define __BLOOM_FILTER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Set membership with false positives but no false negatives, in about
+// ten bits per key at a 1 % false positive rate. Not thread-safe for
+// writers; build it once, then share it read-only.
+class bloom_filter
+{
+public:
+    bloom_filter(std::size_t expected_keys, double false_positive_rate);
+
+    void add(std::string_view key);
+    // false: certainly not added; true: probably added
+    bool maybe_contains(std::string_view key) const;
+
+private:
+    std::vector<std::uint64_t> bits_;
+    std::uint64_t num_bits_;
+    unsigned int num_hashes_;
+};
+
+#endif // __BLOOM_FILTER_HPP__
@@ -0,0 +1,166 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include <bsoncxx/types.hpp>
+
+#include "bson_json.hpp"
+#include "helper.hpp"
+
+namespace chrono = std::chrono;
+
+namespace
+{
+    template <typename View>
+    std::string_view sv(View const &v)
+    {
+        return std::string_view(v.data(), v.size());
+    }
+
+    template <typename Number>
+    void append_number(std::string &out, Number value)
+    {
+        char buf[32];
+        auto const result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr);
+    }
+
+    void append_string(std::string &out, std::string_view str)
+    {
+        out += '"';
+        append_json_escaped(out, str);
+        out += '"';
+    }
+
+    // e.g. "2023-05-01T12:00:00.000Z"
+    void append_date(std::string &out, chrono::milliseconds since_epoch)
+    {
+        auto const secs = chrono::floor<chrono::seconds>(since_epoch);
+        auto const msecs = (since_epoch - secs).count();
+        std::time_t const t = static_cast<std::time_t>(secs.count());
+        std::tm tm{};
+        gmtime_r(&t, &tm);
+        char buf[32];
+        std::size_t const n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        std::snprintf(buf + n, sizeof(buf) - n, ".%03dZ", static_cast<int>(msecs));
+        append_string(out, buf);
+    }
+
+    template <typename Filter>
+    void append_fields(std::string &out, bsoncxx::document::view doc, Filter keep)
+    {
+        out += '{';
+        bool first = true;
+        for (auto const &element : doc)
+        {
+            std::string_view const key = sv(element.key());
+            if (!keep(key))
+            {
+                continue;
+            }
+            if (!first)
+            {
+                out += ',';
+            }
+            first = false;
+            append_string(out, key);
+            out += ':';
+            append_json(out, element.get_value());
+        }
+        out += '}';
+    }
+}
+
+void append_json(std::string &out, bsoncxx::document::view doc)
+{
+    append_fields(out, doc, [](std::string_view) { return true; });
+}
+
+void append_json(std::string &out, bsoncxx::array::view array)
+{
+    out += '[';
+    bool first = true;
+    for (auto const &element : array)
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+        append_json(out, element.get_value());
+    }
+    out += ']';
+}
+
+void append_json(std::string &out, bsoncxx::types::bson_value::view const &value)
+{
+    switch (value.type())
+    {
+    case bsoncxx::type::k_double:
+    {
+        double const d = value.get_double().value;
+        if (std::isfinite(d))
+        {
+            append_number(out, d);
+        }
+        else
+        {
+            out += "null";
+        }
+        break;
+    }
+    case bsoncxx::type::k_string:
+        append_string(out, sv(value.get_string().value));
+        break;
+    case bsoncxx::type::k_document:
+        append_json(out, value.get_document().value);
+        break;
+    case bsoncxx::type::k_array:
+        append_json(out, value.get_array().value);
+        break;
+    case bsoncxx::type::k_oid:
+        append_string(out, value.get_oid().value.to_string());
+        break;
+    case bsoncxx::type::k_bool:
+        out += value.get_bool().value ? "true" : "false";
+        break;
+    case bsoncxx::type::k_date:
+        append_date(out, value.get_date().value);
+        break;
+    case bsoncxx::type::k_int32:
+        append_number(out, value.get_int32().value);
+        break;
+    case bsoncxx::type::k_int64:
+        append_number(out, value.get_int64().value);
+        break;
+    default:
+        out += "null";
+        break;
+    }
+}
+
+void append_json_only(std::string &out, bsoncxx::document::view doc, std::initializer_list<std::string_view> keys)
+{
+    append_fields(out, doc, [keys](std::string_view key)
+                  { return std::find(keys.begin(), keys.end(), key) != keys.end(); });
+}
@@ -0,0 +1,43 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BSON_JSON_HPP__
+#define __BSON_JSON_HPP__
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+#include <bsoncxx/array/view.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types/bson_value/view.hpp>
+
+// Writes BSON as relaxed JSON straight into a response body, without the
+// intermediate strings of bsoncxx::to_json(). ObjectIds become their hex
+// string, dates ISO 8601 strings in UTC, all numbers plain JSON numbers
+// (non-finite doubles become null). Types tasks do not use (binary,
+// regex, timestamps, ...) are written as null.
+extern void append_json(std::string &out, bsoncxx::document::view doc);
+extern void append_json(std::string &out, bsoncxx::array::view array);
+// A single value, e.g. element.get_value() of a document or array
+// element (array elements do not convert to document elements).
+extern void append_json(std::string &out, bsoncxx::types::bson_value::view const &value);
+
+// Only the given top-level fields, in document order.
+extern void append_json_only(std::string &out, bsoncxx::document::view doc, std::initializer_list<std::string_view> keys);
+
+#endif // __BSON_JSON_HPP__
@@ -0,0 +1,96 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+
+#include "cancellation.hpp"
+
+namespace chrono = std::chrono;
+
+namespace
+{
+    thread_local cancellation_token *current_token = nullptr;
+}
+
+void cancellation_token::reset()
+{
+    cancelled_ = false;
+    fd_ = -1;
+    next_check_ = 0;
+}
+
+void cancellation_token::cancel()
+{
+    cancelled_ = true;
+}
+
+bool cancellation_token::cancelled() const
+{
+    return cancelled_.load(std::memory_order_relaxed);
+}
+
+void cancellation_token::watch(int fd, chrono::milliseconds interval)
+{
+    interval_ = interval;
+    next_check_ = (chrono::steady_clock::now() + interval_).time_since_epoch().count();
+    fd_ = fd;
+}
+
+bool cancellation_token::poll(chrono::steady_clock::time_point now)
+{
+    if (cancelled())
+    {
+        return true;
+    }
+    int const fd = fd_.load(std::memory_order_relaxed);
+    auto due = next_check_.load(std::memory_order_relaxed);
+    if (fd < 0 || now.time_since_epoch().count() < due)
+    {
+        return false;
+    }
+    // only one thread probes per interval
+    if (!next_check_.compare_exchange_strong(due, (now + interval_).time_since_epoch().count()))
+    {
+        return cancelled();
+    }
+    // A client may shut down its sending side after the request and still
+    // wait for the response (HTTP/1.1 allows it), so EOF alone is no reason
+    // to give up. Only a connection that is reset or hung up in both
+    // directions is gone.
+    pollfd pfd{fd, 0, 0};
+    if (::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+    {
+        cancel();
+    }
+    return cancelled();
+}
+
+cancellation_token *cancellation_token::current()
+{
+    return current_token;
+}
+
+cancellation_scope::cancellation_scope(cancellation_token *token)
+    : previous_(current_token)
+{
+    current_token = token;
+}
+
+cancellation_scope::~cancellation_scope()
+{
+    current_token = previous_;
+}
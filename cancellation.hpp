@@ -0,0 +1,63 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CANCELLATION_HPP__
+#define __CANCELLATION_HPP__
+
+#include <atomic>
+#include <chrono>
+
+// Set when the work for a request is no longer wanted, e.g. because the
+// client hung up. The worker serving the request makes its token current
+// on its thread while the router runs, like request_trace.
+class cancellation_token
+{
+public:
+    void reset();
+    void cancel();
+    bool cancelled() const;
+
+    // Makes poll() check the socket for a reset or hang-up at most once per interval.
+    void watch(int fd, std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    // Returns true if the token was cancelled or the peer has gone away.
+    // Cheap enough to call from a script's line callback.
+    bool poll(std::chrono::steady_clock::time_point now);
+
+    // Token of the request being served on this thread, or nullptr.
+    static cancellation_token *current();
+
+private:
+    friend class cancellation_scope;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<int> fd_{-1};
+    std::chrono::milliseconds interval_{100};
+    std::atomic<std::chrono::steady_clock::rep> next_check_{0};
+};
+
+class cancellation_scope
+{
+public:
+    explicit cancellation_scope(cancellation_token *token);
+    ~cancellation_scope();
+    cancellation_scope(cancellation_scope const &) = delete;
+    cancellation_scope &operator=(cancellation_scope const &) = delete;
+
+private:
+    cancellation_token *previous_;
+};
+
+#endif // __CANCELLATION_HPP__
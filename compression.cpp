@@ -0,0 +1,230 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "compression.hpp"
+#include "helper.hpp"
+#include "metrics.hpp"
+
+namespace
+{
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() &&
+               std::equal(a.cbegin(), a.cend(), b.cbegin(),
+                          [](char x, char y)
+                          { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+    }
+
+    std::string zlib_compress(std::string_view data, int window_bits)
+    {
+        z_stream zs{};
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("deflateInit2() failed");
+        }
+        std::string out;
+        out.resize(deflateBound(&zs, static_cast<uLong>(data.size())));
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        zs.avail_in = static_cast<uInt>(data.size());
+        zs.next_out = reinterpret_cast<Bytef *>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        int rc = deflate(&zs, Z_FINISH);
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END)
+        {
+            throw std::runtime_error("deflate() failed");
+        }
+        out.resize(zs.total_out);
+        return out;
+    }
+
+#ifdef WITH_BROTLI
+    std::string brotli_compress(std::string_view data)
+    {
+        std::string out;
+        out.resize(BrotliEncoderMaxCompressedSize(data.size()));
+        std::size_t encoded_size = out.size();
+        if (!BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                   data.size(), reinterpret_cast<uint8_t const *>(data.data()),
+                                   &encoded_size, reinterpret_cast<uint8_t *>(out.data())))
+        {
+            throw std::runtime_error("BrotliEncoderCompress() failed");
+        }
+        out.resize(encoded_size);
+        return out;
+    }
+#endif
+}
+
+char const *to_string(content_encoding encoding)
+{
+    switch (encoding)
+    {
+    case content_encoding::deflate:
+        return "deflate";
+    case content_encoding::gzip:
+        return "gzip";
+    case content_encoding::br:
+        return "br";
+    default:
+        return "identity";
+    }
+}
+
+content_encoding negotiate_encoding(std::string_view accept_encoding)
+{
+    content_encoding best = content_encoding::identity;
+    double best_q = 0.0;
+    while (!accept_encoding.empty())
+    {
+        auto comma = accept_encoding.find(',');
+        std::string_view item = trim(accept_encoding.substr(0, comma));
+        accept_encoding.remove_prefix(comma == std::string_view::npos ? accept_encoding.size() : comma + 1);
+        double q = 1.0;
+        auto semicolon = item.find(';');
+        if (semicolon != std::string_view::npos)
+        {
+            std::string_view params = trim(item.substr(semicolon + 1));
+            if (params.size() > 2 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=')
+            {
+                q = std::strtod(std::string(params.substr(2)).c_str(), nullptr);
+            }
+            item = trim(item.substr(0, semicolon));
+        }
+        content_encoding candidate;
+        if (iequals(item, "gzip") || item == "*")
+        {
+            candidate = content_encoding::gzip;
+        }
+        else if (iequals(item, "deflate"))
+        {
+            candidate = content_encoding::deflate;
+        }
+#ifdef WITH_BROTLI
+        else if (iequals(item, "br"))
+        {
+            candidate = content_encoding::br;
+        }
+#endif
+        else
+        {
+            continue;
+        }
+        // on equal weights prefer the stronger encoding (br > gzip > deflate)
+        if (q > best_q || (q > 0.0 && q == best_q && candidate > best))
+        {
+            best = candidate;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
+std::string compress(std::string_view data, content_encoding encoding)
+{
+    std::string out;
+    switch (encoding)
+    {
+    case content_encoding::deflate:
+        out = zlib_compress(data, MAX_WBITS);
+        break;
+    case content_encoding::gzip:
+        out = zlib_compress(data, MAX_WBITS + 16);
+        break;
+#ifdef WITH_BROTLI
+    case content_encoding::br:
+        out = brotli_compress(data);
+        break;
+#endif
+    default:
+        return std::string(data);
+    }
+    metrics().compression_bytes_in += data.size();
+    metrics().compression_bytes_out += out.size();
+    return out;
+}
+
+compression_cache::compression_cache(std::size_t capacity_bytes)
+    : capacity_(capacity_bytes)
+{
+}
+
+std::shared_ptr<std::string const> compression_cache::get(std::string const &body, content_encoding encoding)
+{
+    std::uint64_t const key = fnv1a_hash(body) ^ static_cast<std::uint64_t>(encoding);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it != index_.end() && it->second->original == body)
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++metrics().compression_cache_hits;
+            metrics().compression_bytes_in += body.size();
+            metrics().compression_bytes_out += it->second->compressed->size();
+            return it->second->compressed;
+        }
+    }
+    ++metrics().compression_cache_misses;
+    auto compressed = std::make_shared<std::string const>(compress(body, encoding));
+    std::size_t const cost = body.size() + compressed->size();
+    if (cost > capacity_)
+    {
+        return compressed;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        size_ -= it->second->original.size() + it->second->compressed->size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    while (size_ + cost > capacity_ && !lru_.empty())
+    {
+        entry const &victim = lru_.back();
+        size_ -= victim.original.size() + victim.compressed->size();
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+    lru_.push_front(entry{key, body, compressed});
+    index_[key] = lru_.begin();
+    size_ += cost;
+    return compressed;
+}
@@ -0,0 +1,70 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COMPRESSION_HPP__
+#define __COMPRESSION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+enum class content_encoding
+{
+    identity,
+    deflate,
+    gzip,
+    br
+};
+
+extern char const *to_string(content_encoding encoding);
+
+// Picks the best encoding we support from an Accept-Encoding header value.
+extern content_encoding negotiate_encoding(std::string_view accept_encoding);
+
+extern std::string compress(std::string_view data, content_encoding encoding);
+
+// Keeps compressed variants of bodies that are served over and over again,
+// e.g. task lists, so that they only have to be compressed once.
+class compression_cache
+{
+public:
+    explicit compression_cache(std::size_t capacity_bytes = 16 * 1024 * 1024);
+    compression_cache(compression_cache const &) = delete;
+    compression_cache &operator=(compression_cache const &) = delete;
+
+    std::shared_ptr<std::string const> get(std::string const &body, content_encoding encoding);
+
+private:
+    struct entry
+    {
+        std::uint64_t key;
+        std::string original;
+        std::shared_ptr<std::string const> compressed;
+    };
+    std::size_t capacity_;
+    std::size_t size_{0};
+    std::list<entry> lru_;
+    std::unordered_map<std::uint64_t, std::list<entry>::iterator> index_;
+    std::mutex mtx_;
+};
+
+#endif // __COMPRESSION_HPP__
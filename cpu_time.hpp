@@ -0,0 +1,43 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CPU_TIME_HPP__
+#define __CPU_TIME_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+
+// CPU time the calling thread has used so far. Unlike wall-clock time it
+// does not grow while the thread waits for a core, so budgets and timings
+// based on it stay fair when the machine is loaded. It is a system call,
+// not a vDSO read, so callers keep it out of per-line paths.
+inline std::chrono::nanoseconds thread_cpu_time()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+struct test_timing
+{
+    std::size_t test; // index into the task's tests
+    std::chrono::nanoseconds cpu;
+    std::chrono::nanoseconds wall;
+};
+
+#endif // __CPU_TIME_HPP__
@@ -0,0 +1,401 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+
+#include "execution_request.hpp"
+
+namespace
+{
+    class decoder
+    {
+    public:
+        decoder(std::string_view body, std::string &error)
+            : p_(body.data())
+            , end_(body.data() + body.size())
+            , error_(error)
+        {
+        }
+
+        void skip_ws()
+        {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            {
+                ++p_;
+            }
+        }
+
+        bool expect(char c)
+        {
+            skip_ws();
+            if (p_ == end_ || *p_ != c)
+            {
+                return fail(std::string("expected '") + c + "'");
+            }
+            ++p_;
+            return true;
+        }
+
+        bool peek(char c)
+        {
+            skip_ws();
+            return p_ < end_ && *p_ == c;
+        }
+
+        bool at_end()
+        {
+            skip_ws();
+            return p_ == end_;
+        }
+
+        // Field names are matched verbatim; none of ours needs escaping.
+        bool key(std::string_view &name)
+        {
+            if (!expect('"'))
+            {
+                return false;
+            }
+            char const *begin = p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\')
+            {
+                ++p_;
+            }
+            if (p_ == end_ || *p_ != '"')
+            {
+                return fail("unsupported field name");
+            }
+            name = std::string_view(begin, static_cast<std::size_t>(p_ - begin));
+            ++p_;
+            return true;
+        }
+
+        // Reads a string value. The result views the body if the string has
+        // no escapes; otherwise it is unescaped into buffer.
+        bool string(std::string_view field, std::size_t max_length, std::string_view &value, std::string &buffer)
+        {
+            if (!peek('"'))
+            {
+                return fail("field \"" + std::string(field) + "\" must be a string");
+            }
+            ++p_;
+            char const *begin = p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\')
+            {
+                if (static_cast<unsigned char>(*p_) < 0x20)
+                {
+                    return fail("control character in field \"" + std::string(field) + "\"");
+                }
+                if (static_cast<std::size_t>(p_ - begin) >= max_length)
+                {
+                    return too_long(field);
+                }
+                ++p_;
+            }
+            if (p_ == end_)
+            {
+                return fail("unterminated string");
+            }
+            if (*p_ == '"')
+            {
+                value = std::string_view(begin, static_cast<std::size_t>(p_ - begin));
+                ++p_;
+                return true;
+            }
+            buffer.assign(begin, static_cast<std::size_t>(p_ - begin));
+            while (p_ < end_ && *p_ != '"')
+            {
+                char c = *p_++;
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    return fail("control character in field \"" + std::string(field) + "\"");
+                }
+                if (c == '\\')
+                {
+                    if (p_ == end_)
+                    {
+                        break;
+                    }
+                    switch (*p_++)
+                    {
+                    case '"': c = '"'; break;
+                    case '\\': c = '\\'; break;
+                    case '/': c = '/'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case 'u':
+                        if (!unicode_escape(buffer))
+                        {
+                            return false;
+                        }
+                        if (buffer.size() > max_length)
+                        {
+                            return too_long(field);
+                        }
+                        continue;
+                    default:
+                        return fail("invalid escape sequence");
+                    }
+                }
+                buffer.push_back(c);
+                if (buffer.size() > max_length)
+                {
+                    return too_long(field);
+                }
+            }
+            if (p_ == end_)
+            {
+                return fail("unterminated string");
+            }
+            ++p_;
+            value = buffer;
+            return true;
+        }
+
+        // Reads a string of 24 hex digits. No escapes are allowed, so the
+        // result always views the body.
+        bool object_id(std::string_view field, std::string_view &value)
+        {
+            if (!peek('"'))
+            {
+                return fail("field \"" + std::string(field) + "\" must be a string");
+            }
+            ++p_;
+            char const *begin = p_;
+            while (p_ < end_ && *p_ != '"')
+            {
+                char const c = *p_;
+                if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) ||
+                    p_ - begin >= 24)
+                {
+                    return fail("field \"" + std::string(field) + "\" is not an ObjectId");
+                }
+                ++p_;
+            }
+            if (p_ == end_)
+            {
+                return fail("unterminated string");
+            }
+            value = std::string_view(begin, static_cast<std::size_t>(p_ - begin));
+            ++p_;
+            if (value.size() != 24)
+            {
+                return fail("field \"" + std::string(field) + "\" is not an ObjectId");
+            }
+            return true;
+        }
+
+        bool boolean(std::string_view field, bool &value)
+        {
+            skip_ws();
+            std::string_view const rest(p_, static_cast<std::size_t>(end_ - p_));
+            if (rest.substr(0, 4) == "true")
+            {
+                value = true;
+                p_ += 4;
+                return true;
+            }
+            if (rest.substr(0, 5) == "false")
+            {
+                value = false;
+                p_ += 5;
+                return true;
+            }
+            return fail("field \"" + std::string(field) + "\" must be true or false");
+        }
+
+        bool fail(std::string const &message)
+        {
+            if (error_.empty())
+            {
+                error_ = message;
+            }
+            return false;
+        }
+
+    private:
+        char const *p_;
+        char const *end_;
+        std::string &error_;
+
+        bool too_long(std::string_view field)
+        {
+            return fail("field \"" + std::string(field) + "\" is too long");
+        }
+
+        bool hex4(std::uint32_t &cp)
+        {
+            if (end_ - p_ < 4)
+            {
+                return fail("invalid \\u escape");
+            }
+            cp = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char const c = *p_++;
+                cp <<= 4;
+                if (c >= '0' && c <= '9')
+                {
+                    cp |= static_cast<std::uint32_t>(c - '0');
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    cp |= static_cast<std::uint32_t>(c - 'a' + 10);
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    cp |= static_cast<std::uint32_t>(c - 'A' + 10);
+                }
+                else
+                {
+                    return fail("invalid \\u escape");
+                }
+            }
+            return true;
+        }
+
+        bool unicode_escape(std::string &out)
+        {
+            std::uint32_t cp;
+            if (!hex4(cp))
+            {
+                return false;
+            }
+            if (cp >= 0xd800 && cp <= 0xdbff)
+            {
+                std::uint32_t low;
+                if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+                {
+                    return fail("unpaired surrogate in \\u escape");
+                }
+                p_ += 2;
+                if (!hex4(low) || low < 0xdc00 || low > 0xdfff)
+                {
+                    return fail("unpaired surrogate in \\u escape");
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            else if (cp >= 0xdc00 && cp <= 0xdfff)
+            {
+                return fail("unpaired surrogate in \\u escape");
+            }
+            if (cp < 0x80)
+            {
+                out.push_back(static_cast<char>(cp));
+            }
+            else if (cp < 0x800)
+            {
+                out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+            }
+            else if (cp < 0x10000)
+            {
+                out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+            }
+            else
+            {
+                out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+            }
+            return true;
+        }
+    };
+
+}
+
+bool decode_execution_request(std::string_view body, execution_request &request, std::string &error, execution_request_limits const &limits)
+{
+    error.clear();
+    decoder in(body, error);
+    bool seen_task_id = false;
+    bool seen_email = false;
+    bool seen_script = false;
+    bool seen_profile = false;
+    if (!in.expect('{'))
+    {
+        return false;
+    }
+    if (!in.peek('}'))
+    {
+        do
+        {
+            std::string_view name;
+            if (!in.key(name) || !in.expect(':'))
+            {
+                return false;
+            }
+            bool *seen = nullptr;
+            bool ok = false;
+            if (name == "task_id")
+            {
+                seen = &seen_task_id;
+                ok = in.object_id(name, request.task_id);
+            }
+            else if (name == "email")
+            {
+                seen = &seen_email;
+                ok = in.string(name, limits.max_email, request.email, request.email_buffer);
+            }
+            else if (name == "script")
+            {
+                seen = &seen_script;
+                ok = in.string(name, limits.max_script, request.script, request.script_buffer);
+            }
+            else if (name == "profile")
+            {
+                seen = &seen_profile;
+                ok = in.boolean(name, request.profile);
+            }
+            else
+            {
+                return in.fail("unknown field \"" + std::string(name) + "\"");
+            }
+            if (!ok)
+            {
+                return false;
+            }
+            if (*seen)
+            {
+                return in.fail("duplicate field \"" + std::string(name) + "\"");
+            }
+            *seen = true;
+        } while (in.peek(',') && in.expect(','));
+    }
+    if (!in.expect('}'))
+    {
+        return false;
+    }
+    if (!in.at_end())
+    {
+        return in.fail("unexpected data after the request object");
+    }
+    if (!seen_script)
+    {
+        return in.fail("field \"script\" is missing");
+    }
+    if (!seen_task_id)
+    {
+        return in.fail("field \"task_id\" is missing");
+    }
+    return true;
+}
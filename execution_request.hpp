@@ -0,0 +1,55 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EXECUTION_REQUEST_HPP__
+#define __EXECUTION_REQUEST_HPP__
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+struct execution_request_limits
+{
+    std::size_t max_script = 64 * 1024;
+    std::size_t max_email = 254;
+};
+
+// Body of POST /execute. The views point into the request body unless the
+// string contained escape sequences (e.g. newlines in a script), in which
+// case it is unescaped once into the matching buffer.
+struct execution_request
+{
+    std::string_view task_id; // 24 hex digits, never escaped
+    std::string_view email;
+    std::string_view script;
+    bool profile = false;
+
+    std::string email_buffer;
+    std::string script_buffer;
+
+    execution_request() = default;
+    execution_request(execution_request const &) = delete;
+    execution_request &operator=(execution_request const &) = delete;
+};
+
+// Single-pass decoder for the request body. Rejects anything but a flat
+// object with the fields above, duplicate fields, and strings exceeding
+// their limit as soon as the limit is crossed. Returns false and sets
+// error to a message for the client on failure.
+extern bool decode_execution_request(std::string_view body, execution_request &request, std::string &error, execution_request_limits const &limits = {});
+
+#endif // __EXECUTION_REQUEST_HPP__
@@ -0,0 +1,440 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include "grader_pool.hpp"
+#include "../cancellation.hpp"
+#include "../helper.hpp"
+
+namespace net = boost::asio;
+namespace chrono = std::chrono;
+using tcp = net::ip::tcp;
+
+namespace grader
+{
+    namespace
+    {
+        // FNV-1a alone clusters keys that differ only in their last bytes,
+        // like ObjectIds from the same second; the finalizer of splitmix64
+        // spreads them over the ring.
+        std::uint64_t ring_hash(std::string_view data)
+        {
+            std::uint64_t h = fnv1a_hash(data);
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        }
+
+        // how often a call waiting for its answer checks whether the client is still there
+        constexpr chrono::milliseconds CANCEL_POLL_INTERVAL{100};
+    }
+
+    // A blocking client connection. Each connection has an io_context of
+    // its own, so a call can be bounded by running it for the timeout.
+    class rpc_connection
+    {
+    public:
+        bool connect(std::string const &host, std::string const &port, std::chrono::milliseconds timeout)
+        {
+            boost::system::error_code result = net::error::timed_out;
+            tcp::resolver resolver(ioc_);
+            auto const endpoints = resolver.resolve(host, port, result);
+            if (result)
+            {
+                return false;
+            }
+            result = net::error::timed_out;
+            net::async_connect(socket_, endpoints,
+                               [&result](boost::system::error_code ec, tcp::endpoint const &)
+                               {
+                                   result = ec;
+                               });
+            if (!run(timeout) || result)
+            {
+                return false;
+            }
+            socket_.set_option(tcp::no_delay(true));
+            return true;
+        }
+
+        enum class outcome
+        {
+            answered,
+            // the frame was not written completely, so it was not run
+            not_sent,
+            // the frame was written, then the connection failed
+            failed,
+            // the frame was written, the answer did not arrive in time
+            timed_out,
+            // cancel was cancelled before the answer arrived
+            cancelled
+        };
+
+        // Sends a frame and waits for the answer. The connection is unusable after a failure.
+        outcome call(std::string const &frame, frame_header &header, std::string &payload, std::chrono::milliseconds timeout, cancellation_token *cancel = nullptr)
+        {
+            boost::system::error_code result = net::error::timed_out;
+            bool sent = false;
+            net::async_write(
+                socket_, net::buffer(frame),
+                [this, &result, &sent, &header, &payload](boost::system::error_code ec, std::size_t)
+                {
+                    if (ec)
+                    {
+                        result = ec;
+                        return;
+                    }
+                    sent = true;
+                    net::async_read(
+                        socket_, net::buffer(&header, sizeof(header)),
+                        [this, &result, &header, &payload](boost::system::error_code ec, std::size_t)
+                        {
+                            if (ec || !check_header(header))
+                            {
+                                result = ec ? ec : net::error::invalid_argument;
+                                return;
+                            }
+                            payload.resize(header.length);
+                            net::async_read(
+                                socket_, net::buffer(payload),
+                                [&result](boost::system::error_code ec, std::size_t)
+                                {
+                                    result = ec;
+                                });
+                        });
+                });
+            bool const finished = run(timeout, cancel);
+            if (!finished && cancel != nullptr && cancel->cancelled())
+            {
+                return outcome::cancelled;
+            }
+            if (!sent)
+            {
+                return outcome::not_sent;
+            }
+            if (!finished)
+            {
+                return outcome::timed_out;
+            }
+            return result ? outcome::failed : outcome::answered;
+        }
+
+    private:
+        net::io_context ioc_;
+        tcp::socket socket_{ioc_};
+
+        // Returns false if the pending operations did not finish in time or
+        // cancel was cancelled first.
+        bool run(chrono::milliseconds timeout, cancellation_token *cancel = nullptr)
+        {
+            auto const deadline = chrono::steady_clock::now() + timeout;
+            ioc_.restart();
+            for (auto now = chrono::steady_clock::now(); now < deadline; now = chrono::steady_clock::now())
+            {
+                if (cancel != nullptr && cancel->poll(now))
+                {
+                    break;
+                }
+                ioc_.run_for(cancel != nullptr ? std::min<chrono::steady_clock::duration>(deadline - now, CANCEL_POLL_INTERVAL) : deadline - now);
+                if (ioc_.stopped())
+                {
+                    return true;
+                }
+            }
+            boost::system::error_code ec;
+            if (cancel != nullptr && cancel->cancelled())
+            {
+                // reset rather than close, so that the grader notices at once
+                // and stops the script instead of running it to the end
+                socket_.set_option(net::socket_base::linger(true, 0), ec);
+            }
+            socket_.close(ec);
+            ioc_.restart();
+            ioc_.run();
+            return false;
+        }
+    };
+
+    grader_pool::grader_pool(std::vector<std::string> const &addresses, grader_pool_config const &config)
+        : config_(config)
+    {
+        for (auto const &address : addresses)
+        {
+            auto const colon = address.rfind(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+            {
+                throw std::invalid_argument("grader address must be host:port, got \"" + address + "\"");
+            }
+            auto n = std::make_unique<node>();
+            n->address = address;
+            n->host = address.substr(0, colon);
+            n->port = address.substr(colon + 1);
+            for (unsigned int v = 0; v < std::max(1U, config_.virtual_nodes); ++v)
+            {
+                ring_.emplace_back(ring_hash(address + '#' + std::to_string(v)), nodes_.size());
+            }
+            nodes_.push_back(std::move(n));
+        }
+        std::sort(ring_.begin(), ring_.end());
+        health_thread_ = std::thread(&grader_pool::check_health, this);
+    }
+
+    grader_pool::~grader_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(health_mtx_);
+            stopping_ = true;
+        }
+        health_cv_.notify_all();
+        health_thread_.join();
+    }
+
+    std::vector<std::size_t> grader_pool::candidates(bsoncxx::oid const &task_id) const
+    {
+        std::vector<std::size_t> order;
+        if (ring_.empty())
+        {
+            return order;
+        }
+        std::uint64_t const key = ring_hash(std::string_view(task_id.bytes(), bsoncxx::oid::k_oid_length));
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(key, std::size_t{0}));
+        for (std::size_t i = 0; i < ring_.size() && order.size() < nodes_.size(); ++i, ++it)
+        {
+            if (it == ring_.end())
+            {
+                it = ring_.begin();
+            }
+            if (std::find(order.begin(), order.end(), it->second) == order.end())
+            {
+                order.push_back(it->second);
+            }
+        }
+        return order;
+    }
+
+    std::optional<execute_response> grader_pool::execute(execute_request request, call_status &status, cancellation_token *cancel)
+    {
+        // The task's owner on the ring comes first unless it is down or
+        // saturated; saturated graders are still used before giving up.
+        std::vector<std::size_t> const ring_order = candidates(request.task_id);
+        std::vector<std::size_t> order;
+        for (std::size_t idx : ring_order)
+        {
+            node const &n = *nodes_[idx];
+            if (n.healthy && n.inflight < config_.max_inflight)
+            {
+                order.push_back(idx);
+            }
+        }
+        for (std::size_t idx : ring_order)
+        {
+            node const &n = *nodes_[idx];
+            if (n.healthy && n.inflight >= config_.max_inflight)
+            {
+                order.push_back(idx);
+            }
+        }
+        // one budget for all attempts: a refusal must not restart the clock
+        auto const deadline = chrono::steady_clock::now() + config_.execute_deadline;
+        status = call_status::unavailable;
+        for (std::size_t idx : order)
+        {
+            auto const now = chrono::steady_clock::now();
+            if (cancel != nullptr && cancel->poll(now))
+            {
+                status = call_status::cancelled;
+                return std::nullopt;
+            }
+            auto const remaining = chrono::duration_cast<chrono::milliseconds>(deadline - now);
+            if (remaining.count() <= 0)
+            {
+                break;
+            }
+            request.deadline_ms = static_cast<std::uint32_t>(remaining.count());
+            auto response = call(*nodes_[idx], make_frame(frame_type::execute, encode(request)), remaining, cancel, status);
+            if (status != call_status::unavailable)
+            {
+                return response;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<execute_response> grader_pool::call(node &n, std::string const &frame, chrono::milliseconds timeout, cancellation_token *cancel, call_status &status)
+    {
+        ++n.inflight;
+        ++n.calls;
+        std::unique_ptr<rpc_connection> conn;
+        {
+            std::lock_guard<std::mutex> lock(n.idle_mtx);
+            if (!n.idle.empty())
+            {
+                conn = std::move(n.idle.back());
+                n.idle.pop_back();
+            }
+        }
+        if (!conn)
+        {
+            conn = std::make_unique<rpc_connection>();
+            if (!conn->connect(n.host, n.port, std::min(config_.connect_timeout, timeout)))
+            {
+                conn.reset();
+            }
+        }
+        frame_header header{};
+        std::string payload;
+        auto const outcome = conn ? conn->call(frame, header, payload, timeout + config_.reply_grace, cancel)
+                                  : rpc_connection::outcome::not_sent;
+        --n.inflight;
+        if (outcome == rpc_connection::outcome::cancelled)
+        {
+            // neither the grader's fault nor a verdict
+            status = call_status::cancelled;
+            return std::nullopt;
+        }
+        execute_response response;
+        std::string message;
+        if (outcome == rpc_connection::outcome::answered &&
+            static_cast<frame_type>(header.type) == frame_type::result &&
+            decode(payload, response))
+        {
+            status = call_status::ok;
+            std::lock_guard<std::mutex> lock(n.idle_mtx);
+            n.idle.push_back(std::move(conn));
+            return response;
+        }
+        ++n.failures;
+        if (outcome == rpc_connection::outcome::answered &&
+            static_cast<frame_type>(header.type) == frame_type::error &&
+            decode_error(payload, message))
+        {
+            // refused without running it: the next grader may take it
+            std::cerr << "Grader " << n.address << " refused an execution: " << message << std::endl;
+            status = call_status::unavailable;
+            std::lock_guard<std::mutex> lock(n.idle_mtx);
+            n.idle.push_back(std::move(conn));
+            return std::nullopt;
+        }
+        switch (outcome)
+        {
+        case rpc_connection::outcome::not_sent:
+            n.healthy = false;
+            status = call_status::unavailable;
+            break;
+        case rpc_connection::outcome::timed_out:
+            // a slow script, not a dead grader: health checks decide that
+            ++n.timeouts;
+            status = call_status::timed_out;
+            break;
+        default:
+            n.healthy = false;
+            status = call_status::failed;
+            break;
+        }
+        return std::nullopt;
+    }
+
+    void grader_pool::drop_idle(node &n)
+    {
+        std::lock_guard<std::mutex> lock(n.idle_mtx);
+        n.idle.clear();
+    }
+
+    void grader_pool::check_health()
+    {
+        std::vector<std::unique_ptr<rpc_connection>> probes(nodes_.size());
+        std::string const ping = make_frame(frame_type::ping, {});
+        std::unique_lock<std::mutex> lock(health_mtx_);
+        while (!stopping_)
+        {
+            lock.unlock();
+            for (std::size_t i = 0; i < nodes_.size(); ++i)
+            {
+                node &n = *nodes_[i];
+                if (!probes[i])
+                {
+                    probes[i] = std::make_unique<rpc_connection>();
+                    if (!probes[i]->connect(n.host, n.port, config_.connect_timeout))
+                    {
+                        probes[i].reset();
+                        n.healthy = false;
+                        drop_idle(n);
+                        continue;
+                    }
+                }
+                frame_header header{};
+                std::string payload;
+                std::uint32_t queue_depth = 0;
+                if (probes[i]->call(ping, header, payload, config_.connect_timeout) == rpc_connection::outcome::answered &&
+                    static_cast<frame_type>(header.type) == frame_type::pong &&
+                    decode_pong(payload, queue_depth))
+                {
+                    n.queue_depth = queue_depth;
+                    n.healthy = true;
+                }
+                else
+                {
+                    // connections opened before a restart of the grader
+                    // would take the next request down with them
+                    probes[i].reset();
+                    n.healthy = false;
+                    drop_idle(n);
+                }
+            }
+            lock.lock();
+            health_cv_.wait_for(lock, config_.health_interval, [this] { return stopping_; });
+        }
+    }
+
+    std::string grader_pool::to_prometheus() const
+    {
+        std::ostringstream os;
+        auto const family = [&](char const *name, char const *type, char const *help, auto value)
+        {
+            os << "# HELP " << name << ' ' << help << '\n'
+               << "# TYPE " << name << ' ' << type << '\n';
+            for (auto const &n : nodes_)
+            {
+                os << name << "{grader=\"" << n->address << "\"} " << value(*n) << '\n';
+            }
+        };
+        family("angel_grader_up", "gauge", "Whether the grader answered the last call or health check.",
+               [](node const &n) { return n.healthy ? 1 : 0; });
+        family("angel_grader_inflight", "gauge", "Executions this node is waiting for on the grader.",
+               [](node const &n) { return n.inflight.load(std::memory_order_relaxed); });
+        family("angel_grader_queue_depth", "gauge", "Executions queued on the grader at the last health check.",
+               [](node const &n) { return n.queue_depth.load(std::memory_order_relaxed); });
+        family("angel_grader_calls_total", "counter", "Executions sent to the grader.",
+               [](node const &n) { return n.calls.load(std::memory_order_relaxed); });
+        family("angel_grader_failures_total", "counter", "Executions the grader refused, failed or did not answer in time.",
+               [](node const &n) { return n.failures.load(std::memory_order_relaxed); });
+        family("angel_grader_timeouts_total", "counter", "Executions the grader did not answer before the deadline.",
+               [](node const &n) { return n.timeouts.load(std::memory_order_relaxed); });
+        return os.str();
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GRADER_POOL_HPP__
+#define __GRADER_POOL_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "protocol.hpp"
+
+class cancellation_token;
+
+namespace grader
+{
+    struct grader_pool_config
+    {
+        std::chrono::milliseconds connect_timeout{1000};
+        // time a grader may spend on one execution, queueing included; it
+        // is sent along and the grader gives up on the script when it ends
+        std::chrono::milliseconds execute_deadline{60000};
+        // extra wait for the answer to arrive after the deadline
+        std::chrono::milliseconds reply_grace{2000};
+        std::chrono::milliseconds health_interval{1000};
+        // calls in flight to one grader before its tasks spill over to the next one on the ring
+        unsigned int max_inflight{8};
+        unsigned int virtual_nodes{64};
+    };
+
+    class rpc_connection;
+
+    enum class call_status
+    {
+        ok,
+        // no grader took the request
+        unavailable,
+        // a grader took it and failed or hung up
+        failed,
+        // a grader took it and did not answer before the deadline
+        timed_out,
+        // the client went away before the answer arrived
+        cancelled
+    };
+
+    // Distributes executions across grader processes. Tasks are placed on
+    // a consistent-hash ring, so each task keeps going to the same grader
+    // and only the tasks of a grader that leaves or joins move. Graders
+    // that fail a call or a health check are skipped until they answer
+    // a ping again. A request is only sent to the next grader if the
+    // previous one never received it: a script that is slow or crashes its
+    // grader must not be run by all of them in turn.
+    class grader_pool
+    {
+    public:
+        // addresses are "host:port"; throws std::invalid_argument if one is malformed
+        grader_pool(std::vector<std::string> const &addresses, grader_pool_config const &config);
+        ~grader_pool();
+        grader_pool(grader_pool const &) = delete;
+        grader_pool &operator=(grader_pool const &) = delete;
+
+        // Returns nullopt and sets status if no grader ran the script. All
+        // attempts share one execute_deadline; each grader is sent what is
+        // left of it. Stops waiting once cancel is cancelled.
+        std::optional<execute_response> execute(execute_request request, call_status &status, cancellation_token *cancel = nullptr);
+        std::string to_prometheus() const;
+
+    private:
+        struct node
+        {
+            std::string address;
+            std::string host;
+            std::string port;
+            std::atomic<bool> healthy{true};
+            std::atomic<std::uint32_t> inflight{0};
+            std::atomic<std::uint32_t> queue_depth{0};
+            std::atomic<std::uint64_t> calls{0};
+            std::atomic<std::uint64_t> failures{0};
+            std::atomic<std::uint64_t> timeouts{0};
+            std::mutex idle_mtx;
+            std::vector<std::unique_ptr<rpc_connection>> idle;
+        };
+
+        grader_pool_config config_;
+        std::vector<std::unique_ptr<node>> nodes_;
+        std::vector<std::pair<std::uint64_t, std::size_t>> ring_;
+        std::mutex health_mtx_;
+        std::condition_variable health_cv_;
+        bool stopping_{false};
+        std::thread health_thread_;
+
+        std::vector<std::size_t> candidates(bsoncxx::oid const &task_id) const;
+        std::optional<execute_response> call(node &n, std::string const &frame, std::chrono::milliseconds timeout, cancellation_token *cancel, call_status &status);
+        void drop_idle(node &n);
+        void check_health();
+    };
+}
+
+#endif // __GRADER_POOL_HPP__
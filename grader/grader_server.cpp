@@ -0,0 +1,233 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <sstream>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include "grader_server.hpp"
+#include "protocol.hpp"
+#include "../cancellation.hpp"
+#include "../script_execution.hpp"
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+namespace grader
+{
+    class grader_session : public std::enable_shared_from_this<grader_session>
+    {
+    public:
+        grader_session(tcp::socket socket, grader_server &server)
+            : socket_(std::move(socket))
+            , server_(server)
+        {
+        }
+
+        void read_header()
+        {
+            net::async_read(
+                socket_,
+                net::buffer(&header_, sizeof(header_)),
+                [self = shared_from_this()](boost::system::error_code ec, std::size_t)
+                {
+                    if (ec || !check_header(self->header_))
+                    {
+                        // the stream cannot be trusted to be framed: hang up
+                        // so that the client fails at once
+                        self->socket_.close(ec);
+                        return;
+                    }
+                    self->payload_.resize(self->header_.length);
+                    net::async_read(
+                        self->socket_,
+                        net::buffer(self->payload_),
+                        [self](boost::system::error_code ec, std::size_t)
+                        {
+                            if (!ec)
+                            {
+                                self->handle_frame();
+                            }
+                        });
+                });
+        }
+
+    private:
+        tcp::socket socket_;
+        grader_server &server_;
+        frame_header header_{};
+        std::string payload_;
+        std::string reply_;
+        // reply_ is the result of an execution
+        bool executing_{false};
+
+        void handle_frame()
+        {
+            switch (static_cast<frame_type>(header_.type))
+            {
+            case frame_type::ping:
+                reply_ = make_frame(frame_type::pong, encode_pong(server_.queue_depth()));
+                write_reply();
+                break;
+            case frame_type::execute:
+            {
+                if (server_.draining_)
+                {
+                    reply_ = make_frame(frame_type::error, encode_error("grader is shutting down"));
+                    write_reply();
+                    break;
+                }
+                auto request = std::make_shared<execute_request>();
+                if (!decode(payload_, *request))
+                {
+                    reply_ = make_frame(frame_type::error, encode_error("malformed execute request"));
+                    write_reply();
+                    break;
+                }
+                auto const deadline = request->deadline_ms > 0
+                                          ? std::chrono::steady_clock::now() + std::chrono::milliseconds(request->deadline_ms)
+                                          : std::chrono::steady_clock::time_point::max();
+                ++server_.queue_depth_;
+                ++server_.executions_;
+                executing_ = true;
+                net::post(
+                    server_.executors_,
+                    [self = shared_from_this(), request, deadline]
+                    {
+                        std::string reply = std::chrono::steady_clock::now() < deadline
+                                                ? make_frame(frame_type::result, encode(self->execute(*request, deadline)))
+                                                : make_frame(frame_type::error, encode_error("deadline passed while queued"));
+                        --self->server_.queue_depth_;
+                        net::post(
+                            self->socket_.get_executor(),
+                            [self, reply = std::move(reply)]() mutable
+                            {
+                                self->reply_ = std::move(reply);
+                                self->write_reply();
+                            });
+                    });
+                break;
+            }
+            default:
+                reply_ = make_frame(frame_type::error, encode_error("unknown frame type " + std::to_string(header_.type)));
+                write_reply();
+                break;
+            }
+        }
+
+        void write_reply()
+        {
+            net::async_write(
+                socket_,
+                net::buffer(reply_),
+                [self = shared_from_this()](boost::system::error_code ec, std::size_t)
+                {
+                    if (self->executing_)
+                    {
+                        self->executing_ = false;
+                        --self->server_.executions_;
+                    }
+                    if (!ec)
+                    {
+                        self->read_header();
+                    }
+                });
+        }
+
+        execute_response execute(execute_request const &request, std::chrono::steady_clock::time_point deadline)
+        {
+            std::optional<script_profile> profile;
+            execution_options options;
+            options.scheduler = server_.scheduler_;
+            options.deadline = deadline;
+            // the front node resets the connection when its client goes away
+            cancellation_token cancel;
+            cancel.watch(socket_.native_handle());
+            options.cancel = &cancel;
+            if (request.profile)
+            {
+                options.profile = &profile.emplace();
+            }
+            execute_response response;
+            std::stringstream err_log;
+            execution_result const result = execute_script(request.script, server_.tasks_, server_.test_order_, request.task_id, options, response.err_msg, err_log);
+            response.task_found = result.task_found;
+            response.correct = result.correct;
+            response.err_log = err_log.str();
+            response.tests = result.tests;
+            if (profile)
+            {
+                response.profile = profile->to_json();
+            }
+            return response;
+        }
+    };
+
+    grader_server::grader_server(net::io_context &ioc, tcp::endpoint const &endpoint, storage::task_repository &tasks, unsigned int executors, script_scheduler *scheduler)
+        : acceptor_(ioc, endpoint)
+        , tasks_(tasks)
+        , scheduler_(scheduler)
+        , executors_(std::max(1U, executors))
+    {
+    }
+
+    void grader_server::start()
+    {
+        accept();
+    }
+
+    std::uint32_t grader_server::queue_depth() const
+    {
+        return queue_depth_.load(std::memory_order_relaxed);
+    }
+
+    void grader_server::drain()
+    {
+        draining_ = true;
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+    }
+
+    bool grader_server::busy() const
+    {
+        return executions_.load() > 0;
+    }
+
+    void grader_server::accept()
+    {
+        acceptor_.async_accept(
+            [this](boost::system::error_code ec, tcp::socket socket)
+            {
+                if (ec == net::error::operation_aborted || !acceptor_.is_open())
+                {
+                    return;
+                }
+                if (!ec)
+                {
+                    socket.set_option(tcp::no_delay(true));
+                    std::make_shared<grader_session>(std::move(socket), *this)->read_header();
+                }
+                accept();
+            });
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GRADER_SERVER_HPP__
+#define __GRADER_SERVER_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include "../storage/task_repository.hpp"
+#include "../script_scheduler.hpp"
+#include "../test_order.hpp"
+
+namespace grader
+{
+    // Runs scripts on behalf of front nodes. Scripts run on a pool of
+    // executor threads, so the I/O threads stay free to answer pings while
+    // all executors are busy; calls waiting for an executor form the queue
+    // that pongs report.
+    class grader_server
+    {
+        using tcp = boost::asio::ip::tcp;
+
+    public:
+        grader_server(boost::asio::io_context &ioc, tcp::endpoint const &endpoint, storage::task_repository &tasks, unsigned int executors, script_scheduler *scheduler = nullptr);
+        grader_server(grader_server const &) = delete;
+        grader_server &operator=(grader_server const &) = delete;
+        void start();
+        // Executions received but not yet finished.
+        std::uint32_t queue_depth() const;
+        // Stops accepting connections and refuses new executions with an
+        // error frame, so that front nodes send them to another grader.
+        // Executions in progress go on until busy() turns false.
+        void drain();
+        // Whether an execution is in progress or its result still being sent.
+        bool busy() const;
+
+    private:
+        friend class grader_session;
+        tcp::acceptor acceptor_;
+        storage::task_repository &tasks_;
+        script_scheduler *scheduler_;
+        test_order_registry test_order_;
+        boost::asio::thread_pool executors_;
+        std::atomic<std::uint32_t> queue_depth_{0};
+        std::atomic<std::uint32_t> executions_{0};
+        std::atomic<bool> draining_{false};
+
+        void accept();
+    };
+}
+
+#endif // __GRADER_SERVER_HPP__
@@ -0,0 +1,233 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "protocol.hpp"
+
+namespace grader
+{
+    namespace
+    {
+        enum request_flags : std::uint8_t
+        {
+            PROFILE = 1,
+        };
+
+        enum response_flags : std::uint8_t
+        {
+            TASK_FOUND = 1,
+            CORRECT = 2,
+        };
+
+        template <typename T>
+        void put(std::string &out, T value)
+        {
+            out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+        }
+
+        void put_string(std::string &out, std::string_view str)
+        {
+            put(out, static_cast<std::uint32_t>(str.size()));
+            out.append(str);
+        }
+
+        class payload_reader
+        {
+        public:
+            explicit payload_reader(std::string_view payload)
+                : payload_(payload)
+            {
+            }
+
+            template <typename T>
+            bool get(T &value)
+            {
+                if (payload_.size() < sizeof(value))
+                {
+                    return false;
+                }
+                std::memcpy(&value, payload_.data(), sizeof(value));
+                payload_.remove_prefix(sizeof(value));
+                return true;
+            }
+
+            bool get_bytes(void *dst, std::size_t n)
+            {
+                if (payload_.size() < n)
+                {
+                    return false;
+                }
+                std::memcpy(dst, payload_.data(), n);
+                payload_.remove_prefix(n);
+                return true;
+            }
+
+            bool get_string(std::string &str)
+            {
+                std::uint32_t length = 0;
+                if (!get(length) || payload_.size() < length)
+                {
+                    return false;
+                }
+                str.assign(payload_.data(), length);
+                payload_.remove_prefix(length);
+                return true;
+            }
+
+            bool done() const
+            {
+                return payload_.empty();
+            }
+
+        private:
+            std::string_view payload_;
+        };
+    }
+
+    std::string make_frame(frame_type type, std::string_view payload)
+    {
+        frame_header header{};
+        std::memcpy(header.magic, FRAME_MAGIC, sizeof(header.magic));
+        header.length = static_cast<std::uint32_t>(payload.size());
+        header.type = static_cast<std::uint16_t>(type);
+        header.version = PROTOCOL_VERSION;
+        std::string frame;
+        frame.reserve(sizeof(header) + payload.size());
+        frame.append(reinterpret_cast<char const *>(&header), sizeof(header));
+        frame.append(payload);
+        return frame;
+    }
+
+    bool check_header(frame_header const &header)
+    {
+        return std::memcmp(header.magic, FRAME_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == PROTOCOL_VERSION &&
+               header.length <= MAX_FRAME_LENGTH;
+    }
+
+    std::string encode(execute_request const &request)
+    {
+        std::string out;
+        out.reserve(1 + bsoncxx::oid::k_oid_length + 4 + 4 + request.script.size());
+        put(out, static_cast<std::uint8_t>(request.profile ? PROFILE : 0));
+        out.append(request.task_id.bytes(), bsoncxx::oid::k_oid_length);
+        put(out, request.deadline_ms);
+        put_string(out, request.script);
+        return out;
+    }
+
+    std::string encode(execute_response const &response)
+    {
+        std::string out;
+        std::uint8_t flags = 0;
+        if (response.task_found)
+        {
+            flags |= TASK_FOUND;
+        }
+        if (response.correct)
+        {
+            flags |= CORRECT;
+        }
+        put(out, flags);
+        put_string(out, response.err_msg);
+        put_string(out, response.err_log);
+        put_string(out, response.profile);
+        put(out, static_cast<std::uint32_t>(response.tests.size()));
+        for (auto const &t : response.tests)
+        {
+            put(out, static_cast<std::uint32_t>(t.test));
+            put(out, static_cast<std::uint64_t>(t.cpu.count()));
+            put(out, static_cast<std::uint64_t>(t.wall.count()));
+        }
+        return out;
+    }
+
+    std::string encode_pong(std::uint32_t queue_depth)
+    {
+        std::string out;
+        put(out, queue_depth);
+        return out;
+    }
+
+    std::string encode_error(std::string_view message)
+    {
+        std::string out;
+        put_string(out, message);
+        return out;
+    }
+
+    bool decode(std::string_view payload, execute_request &request)
+    {
+        payload_reader reader(payload);
+        std::uint8_t flags = 0;
+        char oid[bsoncxx::oid::k_oid_length];
+        if (!reader.get(flags) || !reader.get_bytes(oid, sizeof(oid)) || !reader.get(request.deadline_ms) || !reader.get_string(request.script) || !reader.done())
+        {
+            return false;
+        }
+        request.task_id = bsoncxx::oid(oid, sizeof(oid));
+        request.profile = (flags & PROFILE) != 0;
+        return true;
+    }
+
+    bool decode(std::string_view payload, execute_response &response)
+    {
+        payload_reader reader(payload);
+        std::uint8_t flags = 0;
+        std::uint32_t count = 0;
+        if (!reader.get(flags) ||
+            !reader.get_string(response.err_msg) ||
+            !reader.get_string(response.err_log) ||
+            !reader.get_string(response.profile) ||
+            !reader.get(count))
+        {
+            return false;
+        }
+        response.tests.clear();
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::uint32_t test = 0;
+            std::uint64_t cpu = 0;
+            std::uint64_t wall = 0;
+            if (!reader.get(test) || !reader.get(cpu) || !reader.get(wall))
+            {
+                return false;
+            }
+            response.tests.push_back(test_timing{test, std::chrono::nanoseconds(cpu), std::chrono::nanoseconds(wall)});
+        }
+        if (!reader.done())
+        {
+            return false;
+        }
+        response.task_found = (flags & TASK_FOUND) != 0;
+        response.correct = (flags & CORRECT) != 0;
+        return true;
+    }
+
+    bool decode_pong(std::string_view payload, std::uint32_t &queue_depth)
+    {
+        payload_reader reader(payload);
+        return reader.get(queue_depth) && reader.done();
+    }
+
+    bool decode_error(std::string_view payload, std::string &message)
+    {
+        payload_reader reader(payload);
+        return reader.get_string(message) && reader.done();
+    }
+}
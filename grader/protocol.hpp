@@ -0,0 +1,98 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GRADER_PROTOCOL_HPP__
+#define __GRADER_PROTOCOL_HPP__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bsoncxx/oid.hpp>
+
+#include "../cpu_time.hpp"
+
+namespace grader
+{
+    // Front nodes and graders exchange length-prefixed frames over TCP:
+    //
+    //   frame_header | payload[length]
+    //
+    // Strings in payloads are a uint32 length followed by the bytes. All
+    // integers are little-endian. A connection carries one call at a time.
+    enum class frame_type : std::uint16_t
+    {
+        execute = 1, // front -> grader: execute_request
+        result = 2,  // grader -> front: execute_response
+        ping = 3,    // front -> grader: empty
+        pong = 4,    // grader -> front: uint32 queue depth
+        error = 5,   // grader -> front: string message, the request was not run
+    };
+
+    struct frame_header
+    {
+        char magic[4];
+        std::uint32_t length;
+        std::uint16_t type;
+        std::uint16_t version;
+        std::uint32_t reserved;
+    };
+
+    static_assert(sizeof(frame_header) == 16);
+
+    constexpr char FRAME_MAGIC[4] = {'A', 'G', 'R', 'D'};
+    constexpr std::uint16_t PROTOCOL_VERSION = 3;
+    constexpr std::uint32_t MAX_FRAME_LENGTH = 16 * 1024 * 1024;
+
+    struct execute_request
+    {
+        bsoncxx::oid task_id;
+        bool profile = false;
+        std::string script;
+        // wall time the grader may spend on the call, queueing included;
+        // 0 for no limit beyond the per-test ceiling
+        std::uint32_t deadline_ms = 0;
+    };
+
+    struct execute_response
+    {
+        bool task_found = false;
+        bool correct = false;
+        std::string err_msg;
+        std::string err_log;
+        std::string profile; // JSON, empty if not requested
+        // uint32 count, then per test: uint32 index, uint64 CPU ns, uint64 wall ns
+        std::vector<test_timing> tests;
+    };
+
+    extern std::string make_frame(frame_type type, std::string_view payload);
+    // Returns false if the header is not one of ours or announces an oversized payload.
+    extern bool check_header(frame_header const &header);
+
+    extern std::string encode(execute_request const &request);
+    extern std::string encode(execute_response const &response);
+    extern std::string encode_pong(std::uint32_t queue_depth);
+    extern std::string encode_error(std::string_view message);
+    // The decoders return false on truncated or malformed payloads.
+    extern bool decode(std::string_view payload, execute_request &request);
+    extern bool decode(std::string_view payload, execute_response &response);
+    extern bool decode_pong(std::string_view payload, std::uint32_t &queue_depth);
+    extern bool decode_error(std::string_view payload, std::string &message);
+}
+
+#endif // __GRADER_PROTOCOL_HPP__
@@ -0,0 +1,151 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "handlers.hpp"
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <boost/beast/http/string_body.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <bsoncxx/exception/exception.hpp>
+
+#include <angelscript.h>
+
+#include "../helper.hpp"
+#include "../metrics.hpp"
+#include "../script_engine.hpp"
+
+namespace pt = boost::property_tree;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+namespace
+{
+    std::string compile(std::string const &script, std::string const *signature)
+    {
+        std::vector<compile_diagnostic> diagnostics;
+        bool compiled = false;
+        bool signature_found = false;
+        asIScriptEngine *engine = create_script_engine();
+        if (engine == nullptr)
+        {
+            diagnostics.push_back(compile_diagnostic{"", 0, 0, "ERROR", "Failed to create script engine."});
+        }
+        else
+        {
+            engine->SetMessageCallback(asFUNCTION(DiagnosticCallback), &diagnostics, asCALL_CDECL);
+            asIScriptModule *mod = engine->GetModule(0, asGM_ALWAYS_CREATE);
+            compiled = mod->AddScriptSection("script", script.c_str(), script.size()) >= 0 && mod->Build() >= 0;
+            if (compiled && signature != nullptr)
+            {
+                signature_found = mod->GetFunctionByDecl(signature->c_str()) != nullptr;
+                if (!signature_found)
+                {
+                    diagnostics.push_back(compile_diagnostic{"script", 0, 0, "ERROR", "The function `" + *signature + "` could not be found."});
+                }
+            }
+            engine->ShutDownAndRelease();
+        }
+        std::ostringstream os;
+        os << "{\"compiled\":" << (compiled ? "true" : "false");
+        if (signature != nullptr)
+        {
+            os << ",\"signature_found\":" << (signature_found ? "true" : "false");
+        }
+        os << ",\"diagnostics\":[";
+        for (std::size_t i = 0; i < diagnostics.size(); ++i)
+        {
+            compile_diagnostic const &d = diagnostics[i];
+            os << (i > 0 ? "," : "")
+               << "{\"section\":\"" << json_escape(d.section) << "\""
+               << ",\"row\":" << d.row
+               << ",\"column\":" << d.col
+               << ",\"severity\":\"" << d.severity << "\""
+               << ",\"message\":\"" << json_escape(d.message) << "\"}";
+        }
+        os << "]}";
+        return os.str();
+    }
+}
+
+handle_compile::handle_compile(storage::task_repository &tasks, std::size_t cache_size)
+    : tasks(tasks)
+    , cache(std::make_shared<lru_cache<std::string, compile_cache_entry>>(cache_size))
+{
+}
+
+trip::response handle_compile::operator()(trip::request const &req, std::regex const &)
+{
+    pt::ptree request;
+    std::stringstream iss;
+    iss << req.body();
+    try
+    {
+        pt::read_json(iss, request);
+    }
+    catch (pt::ptree_error const &e)
+    {
+        return trip::response{http::status::bad_request, "{\"error\": \"" + json_escape(e.what()) + "\"}"};
+    }
+    if (request.find("script") == request.not_found())
+    {
+        return trip::response{http::status::bad_request, "{\"error\": \"field \\\"script\\\" is missing\"}"};
+    }
+    std::string const script = request.get<std::string>("script");
+    std::string const task_id = request.get<std::string>("task_id", "");
+    // Keyed on the task id rather than its signature, so that a hit needs
+    // no task lookup: repeated compiles while typing stay free. Entries
+    // are only added after the task was found.
+    std::string const key = to_hex(fnv1a_hash(script)) + ':' + task_id;
+    auto cached = cache->get(key);
+    if (cached && cached->script == script)
+    {
+        ++metrics().compile_cache_hits;
+        return trip::response{http::status::ok, cached->response};
+    }
+    std::string signature;
+    if (!task_id.empty())
+    {
+        storage::task_ptr task;
+        try
+        {
+            task = tasks.find(bsoncxx::oid(task_id));
+        }
+        catch (bsoncxx::exception const &e)
+        {
+            return trip::response{http::status::bad_request, e.what(), "text/plain"};
+        }
+        if (!task)
+        {
+            return trip::response{http::status::not_found, "{\"error\": \"task not found\"}"};
+        }
+        auto sig = task->view()["signature"];
+        if (!sig || sig.type() != bsoncxx::type::k_string)
+        {
+            return trip::response{http::status::internal_server_error, "{\"error\": \"task has no valid signature\"}"};
+        }
+        signature = sig.get_string().value.to_string();
+    }
+    ++metrics().compile_cache_misses;
+    std::string response = compile(script, task_id.empty() ? nullptr : &signature);
+    cache->put(key, compile_cache_entry{script, response});
+    return trip::response{http::status::ok, std::move(response)};
+}
@@ -24,7 +24,9 @@
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include <cctype>
 #include <memory>
+#include <optional>
 
 #include <boost/asio/io_context.hpp>
 #include <boost/beast/http/string_body.hpp>
@@ -33,12 +35,7 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/url.hpp>
 
-#include <mongocxx/cursor.hpp>
 #include <bsoncxx/json.hpp>
-#include <bsoncxx/exception/exception.hpp>
-#include <bsoncxx/builder/stream/helpers.hpp>
-#include <bsoncxx/builder/stream/document.hpp>
-#include <bsoncxx/builder/stream/array.hpp>
 
 namespace pt = boost::property_tree;
 namespace beast = boost::beast;
@@ -46,297 +43,169 @@ namespace http = beast::http;
 namespace chrono = std::chrono;
 namespace url = boost::urls;
 
-#include <angelscript.h>
-#include <scriptstdstring/scriptstdstring.h>
-#include <scriptmath/scriptmath.h>
-
-void PrintString(std::string const &s)
-{
-    std::cout << s << std::endl;
-}
-
-void PrintString_Generic(asIScriptGeneric *gen)
-{
-    const std::string *const str = reinterpret_cast<std::string *>(gen->GetArgAddress(0));
-    std::cout << *str << std::endl;
-}
-
-#ifdef __GNUC__
-void LineCallback(asIScriptContext *ctx, chrono::system_clock::time_point *timeout)
-#else
-void LineCallback(asIScriptContext *ctx, chrono::steady_clock::time_point *timeout)
-#endif
-{
-    if (*timeout < chrono::high_resolution_clock::now())
-    {
-        ctx->Abort();
-    }
-}
-
-void MessageCallback(const asSMessageInfo *msg, std::stringstream *out)
-{
-    *out << "[";
-    switch (msg->type)
-    {
-    case asMSGTYPE_WARNING:
-        *out << "WARN";
-        break;
-    case asMSGTYPE_INFORMATION:
-        *out << "INFO";
-        break;
-    case asMSGTYPE_ERROR:
-        *out << "ERROR";
-        break;
-    default:
-        *out << "LOG";
-        break;
-    }
-    *out << "] " << msg->section << " (" << msg->row << ", " << msg->col << ") " << msg->message << std::endl;
-}
-
-bool approximately_equal(float a, float b, float epsilon = 0.000001)
+#include "../execution_request.hpp"
+#include "../cancellation.hpp"
+#include "../helper.hpp"
+#include "../metrics.hpp"
+#include "../script_execution.hpp"
+#include "../request_trace.hpp"
+
+handle_execution::handle_execution(storage::task_repository &tasks, storage::submission_journal *journal, stats_registry *stats, grader::grader_pool *graders, rate_limiter *email_limiter, script_scheduler *scheduler, inflight_registry *inflight)
+    : tasks(tasks)
+    , journal(journal)
+    , stats(stats)
+    , graders(graders)
+    , email_limiter(email_limiter)
+    , scheduler(scheduler)
+    , inflight(inflight)
+    , test_order(std::make_shared<test_order_registry>())
 {
-    return fabs(a - b) <= ((fabs(a) < fabs(b) ? fabs(b) : fabs(a)) * epsilon);
 }
-
-bool execute_script(std::string const &script, mongocxx::collection &coll, bsoncxx::oid const &oid, std::string &err_msg, std::stringstream &err_log)
+trip::response handle_execution::operator()(trip::request const &req, std::regex const &)
 {
-    auto query = bsoncxx::builder::stream::document{}
-                 << "_id"
-                 << oid
-                 << bsoncxx::builder::stream::finalize;
-    auto result = coll.find_one(std::move(query));
-    if (!result)
+    execution_request request;
+    std::string error;
+    if (!decode_execution_request(std::string_view(req.body()), request, error))
     {
-        err_log << "OID »" << oid.to_string() << "« not found in database." << std::endl;
-        return false;
+        return trip::response{http::status::bad_request, "{\"error\": \"" + json_escape(error) + "\"}"};
     }
-#ifndef NDEBUG
-    err_log << "[DEBUG]" << bsoncxx::to_json(*result) << std::endl;
-#endif
-
-    if (!result->view()["tests"])
+    bsoncxx::oid const oid(request.task_id);
+    if (!tasks.may_contain(oid))
     {
-        err_log << "Field \"tests\" not found in database." << std::endl;
-        return false;
+        // before the email limiter and the grader: a mistyped id should
+        // cost neither a submission nor a script run
+        return trip::response{http::status::not_found, "{\"error\": \"unknown task\"}"};
     }
-    if (result->view()["tests"].type() != bsoncxx::type::k_array)
+    std::string_view const email = request.email;
+    if (email_limiter != nullptr && !email.empty())
     {
-        err_log << "Field \"tests\" is not an array." << std::endl;
-        return false;
-    }
-    auto tests = result->view()["tests"].get_array().value;
-
-    if (!result->view()["signature"])
-    {
-        err_log << "Field \"signature\" missing in task." << std::endl;
-        return false;
-    }
-    if (result->view()["signature"].type() != bsoncxx::type::k_string)
-    {
-        err_log << "Field \"signature\" is not a string." << std::endl;
-        return false;
-    }
-    auto signature = result->view()["signature"].get_string().value;
-
-    int rc;
-    asIScriptEngine *engine = asCreateScriptEngine();
-    if (engine == nullptr)
-    {
-        std::cerr << "Failed to create script engine." << std::endl;
-        return false;
-    }
-    rc = engine->SetMessageCallback(asFUNCTION(MessageCallback), &err_log, asCALL_CDECL);
-
-    RegisterStdString(engine);
-    RegisterScriptMath_Native(engine);
-
-    asIScriptModule *mod = engine->GetModule(0, asGM_ALWAYS_CREATE);
-    rc = mod->AddScriptSection("script", script.c_str(), script.size());
-    if (rc < 0)
-    {
-        err_log << "AddScriptSection() failed." << std::endl;
-        engine->Release();
-        return false;
-    }
-    rc = mod->Build();
-    if (rc < 0)
-    {
-        err_log << "Build failed." << std::endl;
-        engine->Release();
-        return false;
-    }
-    asIScriptContext *ctx = engine->CreateContext();
-    if (ctx == nullptr)
-    {
-        err_log << "Failed to create the context." << std::endl;
-        engine->Release();
-        return false;
-    }
-    asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl(signature.to_string().c_str());
-    if (func == nullptr)
-    {
-        err_log << "The function `" << signature.to_string() << "` could not be found." << std::endl;
-        ctx->Release();
-        engine->ShutDownAndRelease();
-        return false;
-    }
-    bool correct = true;
-    for (auto const &test : tests)
-    {
-        rc = ctx->Prepare(func);
-        if (rc < 0)
-        {
-            err_log << "Failed to prepare the context." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
-        }
-        if (!test["input"])
-        {
-            err_log << "Field \"input\" missing in task." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
-        }
-        if (test["input"].type() != bsoncxx::type::k_array)
+        std::string key(email);
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        auto const retry_after = email_limiter->acquire(key);
+        if (retry_after)
         {
-            err_log << "Field \"input\" is not an array." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
+            ++metrics().rate_limited_email;
+            return trip::response{http::status::too_many_requests, "{\"error\": \"too many submissions, try again later\"}", "application/json", false, {{http::field::retry_after, std::to_string(retry_after->count())}}};
         }
-        auto input = test["input"].get_array().value;
-        if (!test["output"])
+    }
+    auto t0 = chrono::high_resolution_clock::now();
+    std::stringstream err_log;
+    std::string err_msg;
+    std::string_view const script = request.script;
+    bool const want_profile = request.profile;
+    std::optional<std::string> profile;
+    execution_result result;
+    if (graders != nullptr)
+    {
+        grader::call_status status;
+        auto remote = graders->execute(grader::execute_request{oid, want_profile, std::string(script)}, status, cancellation_token::current());
+        if (status == grader::call_status::cancelled)
         {
-            err_log << "Field \"output\" missing in task." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
+            ++metrics().cancelled_executions;
+            return trip::response{http::status::service_unavailable, "{\"error\": \"cancelled\"}"};
         }
-        if (test["output"].type() != bsoncxx::type::k_double)
+        if (status == grader::call_status::timed_out)
         {
-            err_log << "Field \"output\" is not a double." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
+            return trip::response{http::status::gateway_timeout, "{\"error\": \"the submission did not finish in time\"}"};
         }
-        auto output = test["output"].get_double().value;
-        asUINT arg_idx = 0U;
-        for (auto i = input.cbegin(); i != input.cend(); ++i)
+        if (status == grader::call_status::failed)
         {
-            if (i->type() != bsoncxx::type::k_double)
-            {
-                err_log << "Field \"output\" does not contain double values." << std::endl;
-                ctx->Release();
-                engine->ShutDownAndRelease();
-                return false;
-            }
-            ctx->SetArgFloat(arg_idx++, static_cast<float>(i->get_double().value));
+            return trip::response{http::status::bad_gateway, "{\"error\": \"the grader failed\"}"};
         }
-        auto timeout = chrono::high_resolution_clock::now() + chrono::seconds(5);
-        rc = ctx->SetLineCallback(asFUNCTION(LineCallback), &timeout, asCALL_CDECL);
-        if (rc < 0)
+        if (!remote)
         {
-            err_log << "Failed to set the line callback function." << std::endl;
-            ctx->Release();
-            engine->ShutDownAndRelease();
-            return false;
+            return trip::response{http::status::service_unavailable, "{\"error\": \"no grader available\"}", "application/json", false, {{http::field::retry_after, "5"}}};
         }
-        rc = ctx->Execute();
-        if (rc == asEXECUTION_FINISHED)
+        result = execution_result{remote->task_found, remote->correct};
+        for (auto const &t : remote->tests)
         {
-            auto return_value = ctx->GetReturnFloat();
-            correct &= approximately_equal(output, return_value);
+            result.cpu += t.cpu;
         }
-        else if (rc == asEXECUTION_ABORTED)
+        result.tests = std::move(remote->tests);
+        err_msg = std::move(remote->err_msg);
+        err_log << remote->err_log;
+        if (want_profile)
         {
-            err_log << "The script was aborted before it could finish. Probably it timed out." << std::endl;
-            correct = false;
-            break;
+            profile = std::move(remote->profile);
         }
-        else if (rc == asEXECUTION_EXCEPTION)
+    }
+    else
+    {
+        std::optional<script_profile> local_profile;
+        execution_options options;
+        options.scheduler = scheduler;
+        options.cancel = cancellation_token::current();
+        options.inflight = inflight;
+        if (want_profile)
         {
-            err_log << "The script ended with an exception." << std::endl;
-            asIScriptFunction *func = ctx->GetExceptionFunction();
-            err_log << "func: " << func->GetDeclaration() << std::endl;
-            err_log << "modl: " << func->GetModuleName() << std::endl;
-            err_log << "sect: " << func->GetScriptSectionName() << std::endl;
-            err_log << "line: " << ctx->GetExceptionLineNumber() << std::endl;
-            err_log << "desc: " << ctx->GetExceptionString() << std::endl;
-            correct = false;
-            break;
+            options.profile = &local_profile.emplace();
         }
-        else
+        result = execute_script(script, tasks, *test_order, oid, options, err_msg, err_log);
+        if (local_profile)
         {
-            err_log << "The script ended for some unforeseen reason (result code = " << rc << ")." << std::endl;
-            correct = false;
-            break;
+            profile = local_profile->to_json();
         }
     }
-
-    ctx->Release();
-    engine->ShutDownAndRelease();
-
-    if (!correct)
-    {
-        err_msg = "Your script failed in at least one test. Try again.";
-    }
-    return correct;
-}
-
-
-handle_execution::handle_execution(mongocxx::collection &coll)
-    : coll(coll)
-{
-}
-trip::response handle_execution::operator()(trip::request const &req, std::regex const &)
-{
-    pt::ptree request;
-    std::stringstream iss;
-    iss << req.body();
-    try
-    {
-        pt::read_json(iss, request);
-    }
-    catch (pt::ptree_error const &e)
-    {
-        return trip::response{http::status::bad_request, "{\"error\": \"" + std::string(e.what()) + "\""};
-    }
-    if (request.find("script") == request.not_found())
+    if (result.cancelled)
     {
-        return trip::response{http::status::bad_request, "{\"error\": \"field \\\"script\\\" is missing\"}"};
+        // not a verdict: keep it out of the journal and the statistics
+        return trip::response{http::status::service_unavailable, "{\"error\": \"cancelled\"}"};
     }
-    if (request.find("task_id") == request.not_found())
-    {
-        return trip::response{http::status::bad_request, "{\"error\": \"field \\\"task_id\\\" is missing\"}"};
-    }
-    try
-    {
-        bsoncxx::oid oid(request.get<std::string>("task_id"));
-    }
-    catch(bsoncxx::exception const& e)
-    {
-        return trip::response{http::status::bad_request, e.what(), "text/plain"};
-    }
-    bsoncxx::oid oid(request.get<std::string>("task_id"));
-    auto t0 = chrono::high_resolution_clock::now();
-    std::stringstream err_log;
-    std::string err_msg;
-    auto script = request.get<std::string>("script");
-    bool correct = execute_script(script, coll, oid, err_msg, err_log);
+    bool const correct = result.correct;
     auto t1 = chrono::high_resolution_clock::now();
     auto dt = chrono::duration_cast<chrono::duration<double>>(t1 - t0);
+    double const cpu_msecs = chrono::duration<double, std::milli>(result.cpu).count();
+    if (result.task_found)
+    {
+        if (journal != nullptr)
+        {
+            journal->record(storage::submission{
+                oid,
+                std::string(email),
+                correct,
+                1e3 * dt.count(),
+                cpu_msecs,
+                to_hex(fnv1a_hash(script)),
+                chrono::system_clock::now()});
+        }
+        if (stats != nullptr)
+        {
+            // CPU time, so that the leaderboard does not depend on the load
+            stats->record(oid.to_string(), std::string(email), correct, cpu_msecs);
+        }
+    }
+    scoped_span span("serialize");
     pt::ptree response;
     response.put("error", err_msg);
     response.put("messages", err_log.str());
     response.put("elapsed_msecs", "[elapsed_msecs]");
     response.put("correct", "[correct]");
+    response.put("cpu_msecs", "[cpu_msecs]");
+    response.put("tests", "[tests]");
+    if (profile)
+    {
+        response.put("profile", "[profile]");
+    }
     std::ostringstream ss;
     pt::write_json(ss, response, true);
     std::string responseStr = ss.str();
     boost::replace_all(responseStr, "\"[elapsed_msecs]\"", std::to_string(1e3 * dt.count()));
     boost::replace_all(responseStr, "\"[correct]\"", correct ? "true" : "false");
+    boost::replace_all(responseStr, "\"[cpu_msecs]\"", std::to_string(cpu_msecs));
+    std::string tests = "[";
+    for (auto const &t : result.tests)
+    {
+        tests += (tests.size() > 1 ? ", " : "");
+        tests += "{\"test\": " + std::to_string(t.test) +
+                 ", \"cpu_msecs\": " + std::to_string(chrono::duration<double, std::milli>(t.cpu).count()) +
+                 ", \"wall_msecs\": " + std::to_string(chrono::duration<double, std::milli>(t.wall).count()) + "}";
+    }
+    tests += "]";
+    boost::replace_all(responseStr, "\"[tests]\"", tests);
+    if (profile)
+    {
+        boost::replace_all(responseStr, "\"[profile]\"", *profile);
+    }
     return trip::response{http::status::ok, responseStr};
 }
 
@@ -0,0 +1,113 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "handlers.hpp"
+
+#include <chrono>
+#include <string>
+
+#include <boost/beast/http/string_body.hpp>
+#include <boost/url.hpp>
+
+#include "../helper.hpp"
+#include "../metrics.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace chrono = std::chrono;
+namespace url = boost::urls;
+
+namespace
+{
+    std::string msecs(chrono::nanoseconds d)
+    {
+        return std::to_string(chrono::duration<double, std::milli>(d).count());
+    }
+}
+
+handle_inflight::handle_inflight(inflight_registry const &inflight)
+    : inflight(inflight)
+{
+}
+
+trip::response handle_inflight::operator()(trip::request const &, std::regex const &)
+{
+    std::string body = "{\"queues\": {\"scheduler\": " + std::to_string(metrics().scheduler_queue_depth.load()) +
+                       ", \"journal\": " + std::to_string(metrics().journal_queue_depth.load()) + "}";
+    body += ", \"workers\": [";
+    bool first = true;
+    for (auto const &w : inflight.workers())
+    {
+        body += first ? "" : ", ";
+        first = false;
+        body += "{\"worker\": " + std::to_string(w.index) +
+                ", \"state\": \"" + to_string(w.state) + "\"" +
+                ", \"elapsed_msecs\": " + msecs(w.elapsed);
+        if (w.state != worker_state::idle && w.state != worker_state::reading)
+        {
+            body += ", \"method\": \"" + std::string(http::to_string(static_cast<http::verb>(w.method))) + "\"" +
+                    ", \"target\": \"" + json_escape(w.target) + "\"" +
+                    ", \"remote\": \"" + w.remote + "\"";
+        }
+        body += "}";
+    }
+    body += "], \"executions\": [";
+    first = true;
+    for (auto const &e : inflight.executions())
+    {
+        body += first ? "" : ", ";
+        first = false;
+        body += "{\"id\": " + std::to_string(e.id) +
+                ", \"task_id\": \"" + e.task_id + "\"" +
+                ", \"script_hash\": \"" + to_hex(e.script_hash) + "\"" +
+                ", \"elapsed_msecs\": " + msecs(e.elapsed) +
+                ", \"thread\": " + std::to_string(e.thread) +
+                ", \"line\": " + std::to_string(e.line) + "}";
+    }
+    body += "]}";
+    return trip::response{http::status::ok, body};
+}
+
+handle_inflight_abort::handle_inflight_abort(inflight_registry &inflight)
+    : inflight(inflight)
+{
+}
+
+trip::response handle_inflight_abort::operator()(trip::request const &req, std::regex const &re)
+{
+    url::result<url::url_view> const &target = url::parse_origin_form(req.target());
+    std::string const &path = target->path();
+    std::smatch match;
+    if (!std::regex_match(path, match, re))
+    {
+        return trip::response{http::status::bad_request, "{\"error\": \"invalid execution id\"}"};
+    }
+    std::uint64_t id = 0;
+    try
+    {
+        id = std::stoull(match[1].str());
+    }
+    catch (std::exception const &)
+    {
+        return trip::response{http::status::bad_request, "{\"error\": \"invalid execution id\"}"};
+    }
+    if (!inflight.abort(id))
+    {
+        return trip::response{http::status::not_found, "{\"error\": \"no such execution\"}"};
+    }
+    return trip::response{http::status::accepted, "{\"aborted\": " + std::to_string(id) + "}"};
+}
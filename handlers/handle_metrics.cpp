@@ -0,0 +1,40 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "handlers.hpp"
+
+#include <boost/beast/http/string_body.hpp>
+
+#include "../metrics.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+handle_metrics::handle_metrics(grader::grader_pool const *graders)
+    : graders(graders)
+{
+}
+
+trip::response handle_metrics::operator()(trip::request const &, std::regex const &)
+{
+    std::string body = metrics().to_prometheus();
+    if (graders != nullptr)
+    {
+        body += graders->to_prometheus();
+    }
+    return trip::response{http::status::ok, body, "text/plain; version=0.0.4"};
+}
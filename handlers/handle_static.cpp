@@ -0,0 +1,65 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "handlers.hpp"
+
+#include <string>
+
+#include <boost/beast/http/string_body.hpp>
+#include <boost/url.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace url = boost::urls;
+
+handle_static::handle_static(static_assets const &assets)
+    : assets(assets)
+{
+}
+
+trip::response handle_static::operator()(trip::request const &req, std::regex const &)
+{
+    url::result<url::url_view> const &target = url::parse_origin_form(req.target());
+    std::string const &path = target->path();
+    static_assets::asset const *asset = assets.find(path);
+    if (asset == nullptr)
+    {
+        return trip::response{http::status::not_found, path + " not found", "text/plain"};
+    }
+    static_assets::variant const *variant = &asset->identity;
+    auto const accept_encoding = req[http::field::accept_encoding];
+    content_encoding const encoding = negotiate_encoding(std::string_view(accept_encoding.data(), accept_encoding.size()));
+    auto encoded = asset->encoded.find(encoding);
+    if (encoded != asset->encoded.end())
+    {
+        variant = &encoded->second;
+    }
+    trip::response response{http::status::ok, "", asset->mime_type};
+    response.headers.emplace_back(http::field::etag, variant->etag);
+    response.headers.emplace_back(http::field::cache_control, "no-cache");
+    if (variant != &asset->identity)
+    {
+        response.headers.emplace_back(http::field::content_encoding, to_string(encoding));
+    }
+    if (req[http::field::if_none_match] == variant->etag)
+    {
+        response.status = http::status::not_modified;
+        return response;
+    }
+    response.body = variant->body;
+    return response;
+}
@@ -16,24 +16,21 @@
  */
 
 #include "handlers.hpp"
+#include "../bson_json.hpp"
+#include "../request_trace.hpp"
 
 #include <string>
-#include <sstream>
+#include <utility>
 
 #include <boost/beast/http/string_body.hpp>
 #include <boost/url.hpp>
 
-#include <mongocxx/cursor.hpp>
-#include <bsoncxx/json.hpp>
-#include <bsoncxx/builder/stream/helpers.hpp>
-#include <bsoncxx/builder/stream/document.hpp>
-
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace url = boost::urls;
 
-handle_task_list::handle_task_list(mongocxx::collection &coll)
-    : coll(coll)
+handle_task_list::handle_task_list(storage::task_repository &tasks)
+    : tasks(tasks)
 {
 }
 
@@ -47,52 +44,34 @@ trip::response handle_task_list::operator()(trip::request const &req, std::regex
         return trip::response{http::status::no_content, ""};
     }
     std::string const status = match[1];
-    bsoncxx::document::value query = bsoncxx::builder::stream::document{} << bsoncxx::builder::stream::finalize;
+    storage::task_filter filter = storage::task_filter::all;
     if (status == "current")
     {
-        query = bsoncxx::builder::stream::document{}
-               << "valid.from"
-               << bsoncxx::builder::stream::open_document
-               << "$lte"
-               << bsoncxx::types::b_date{std::chrono::system_clock::now()}
-               << bsoncxx::builder::stream::close_document
-               << "valid.until"
-               << bsoncxx::builder::stream::open_document
-               << "$gt"
-               << bsoncxx::types::b_date{std::chrono::system_clock::now()}
-               << bsoncxx::builder::stream::close_document
-               << bsoncxx::builder::stream::finalize;
+        filter = storage::task_filter::current;
     }
     else if (status == "archived")
     {
-        query = bsoncxx::builder::stream::document{}
-               << "valid.until"
-               << bsoncxx::builder::stream::open_document
-               << "$lt"
-               << bsoncxx::types::b_date{std::chrono::system_clock::now()}
-               << bsoncxx::builder::stream::close_document
-               << bsoncxx::builder::stream::finalize;
+        filter = storage::task_filter::archived;
+    }
+    std::vector<storage::task_ptr> list;
+    {
+        scoped_span span("db");
+        list = tasks.list(filter);
     }
-    mongocxx::options::find opts{};
-    opts.projection(bsoncxx::builder::stream::document{}
-                    << "name"
-                    << 1
-                    << "task"
-                    << 1
-                    << bsoncxx::builder::stream::finalize);
-    mongocxx::cursor cursor = coll.find(std::move(query), opts);
-    if (cursor.begin() == cursor.end())
+    if (list.empty())
     {
         return trip::response{http::status::no_content, ""};
     }
 
-    std::ostringstream os;
-    os << "[";
-    for (auto const &task : cursor)
+    scoped_span span("serialize");
+    std::string body;
+    body.reserve(256 * list.size());
+    body += '[';
+    for (auto const &task : list)
     {
-        os << bsoncxx::to_json(task) << ',';
+        append_json_only(body, task->view(), {"_id", "name", "task"});
+        body += ',';
     }
-    os.seekp(-1, os.cur); // remove last comma
-    os << "]";
-    return trip::response{http::status::ok, os.str()};
+    body.back() = ']'; // replaces the last comma
+    return trip::response{http::status::ok, std::move(body), "application/json", true};
 }
@@ -0,0 +1,114 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "handlers.hpp"
+
+#include <string>
+#include <sstream>
+
+#include <boost/beast/http/string_body.hpp>
+#include <boost/url.hpp>
+
+#include "../helper.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace url = boost::urls;
+
+namespace
+{
+    // "someone@example.com" -> "so***@example.com"
+    std::string mask_email(std::string const &email)
+    {
+        auto at = email.find('@');
+        if (at == std::string::npos)
+        {
+            return "***";
+        }
+        return email.substr(0, std::min<std::size_t>(2, at)) + "***" + email.substr(at);
+    }
+
+    task_stats const *find_stats(stats_registry const &stats, trip::request const &req, std::regex const &re, std::string &task_id)
+    {
+        url::result<url::url_view> const &target = url::parse_origin_form(req.target());
+        std::string const &path = target->path();
+        std::smatch match;
+        if (!std::regex_match(path, match, re))
+        {
+            return nullptr;
+        }
+        task_id = match[1].str();
+        return stats.find(task_id);
+    }
+}
+
+handle_task_stats::handle_task_stats(stats_registry const &stats)
+    : stats(stats)
+{
+}
+
+trip::response handle_task_stats::operator()(trip::request const &req, std::regex const &re)
+{
+    std::string task_id;
+    task_stats const *s = find_stats(stats, req, re, task_id);
+    if (s == nullptr)
+    {
+        return trip::response{http::status::no_content, ""};
+    }
+    std::uint64_t const attempts = s->attempts();
+    std::uint64_t const passed = s->passed();
+    std::ostringstream os;
+    os << "{\"task_id\":\"" << task_id << "\""
+       << ",\"attempts\":" << attempts
+       << ",\"passed\":" << passed
+       << ",\"pass_rate\":" << (attempts > 0 ? static_cast<double>(passed) / static_cast<double>(attempts) : 0.0)
+       << ",\"p50_cpu_msecs\":" << s->percentile(0.50)
+       << ",\"p95_cpu_msecs\":" << s->percentile(0.95)
+       << "}";
+    return trip::response{http::status::ok, os.str()};
+}
+
+handle_leaderboard::handle_leaderboard(stats_registry const &stats)
+    : stats(stats)
+{
+}
+
+trip::response handle_leaderboard::operator()(trip::request const &req, std::regex const &re)
+{
+    std::string task_id;
+    task_stats const *s = find_stats(stats, req, re, task_id);
+    if (s == nullptr)
+    {
+        return trip::response{http::status::no_content, ""};
+    }
+    std::ostringstream os;
+    os << "[";
+    int rank = 0;
+    for (auto const &entry : s->leaderboard())
+    {
+        if (++rank > 1)
+        {
+            os << ",";
+        }
+        os << "{\"rank\":" << rank
+           << ",\"email\":\"" << json_escape(mask_email(entry.email)) << "\""
+           << ",\"cpu_msecs\":" << entry.cpu_msecs
+           << "}";
+    }
+    os << "]";
+    return trip::response{http::status::ok, os.str()};
+}
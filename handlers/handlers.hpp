@@ -19,22 +19,40 @@
 #define __HANDLERS_HPP__
 
 #include <regex>
-#include "mongocxx/collection.hpp"
+#include <memory>
+#include <string>
+#include "../storage/task_repository.hpp"
+#include "../storage/submission_journal.hpp"
 #include "../trip/response_request.hpp"
 #include "../trip/handler.hpp"
+#include "../static_assets.hpp"
+#include "../task_stats.hpp"
+#include "../lru_cache.hpp"
+#include "../test_order.hpp"
+#include "../grader/grader_pool.hpp"
+#include "../inflight.hpp"
+#include "../rate_limiter.hpp"
+#include "../script_scheduler.hpp"
 
 
 struct handle_find_task : trip::handler
 {
-    mongocxx::collection &coll;
-    handle_find_task(mongocxx::collection &coll);
+    storage::task_repository &tasks;
+    handle_find_task(storage::task_repository &tasks);
     trip::response operator()(trip::request const &req, std::regex const &re);
 };
 
 struct handle_execution : trip::handler
 {
-    mongocxx::collection &coll;
-    handle_execution(mongocxx::collection &coll);
+    storage::task_repository &tasks;
+    storage::submission_journal *journal;
+    stats_registry *stats;
+    grader::grader_pool *graders;
+    rate_limiter *email_limiter;
+    script_scheduler *scheduler;
+    inflight_registry *inflight;
+    std::shared_ptr<test_order_registry> test_order;
+    handle_execution(storage::task_repository &tasks, storage::submission_journal *journal = nullptr, stats_registry *stats = nullptr, grader::grader_pool *graders = nullptr, rate_limiter *email_limiter = nullptr, script_scheduler *scheduler = nullptr, inflight_registry *inflight = nullptr);
     trip::response operator()(trip::request const &req, std::regex const &);
 };
 
@@ -43,10 +61,66 @@ struct handle_execution_preflight : trip::handler
     trip::response operator()(trip::request const &req, std::regex const &);
 };
 
+struct compile_cache_entry
+{
+    std::string script;
+    std::string response;
+};
+
+struct handle_compile : trip::handler
+{
+    storage::task_repository &tasks;
+    std::shared_ptr<lru_cache<std::string, compile_cache_entry>> cache;
+    handle_compile(storage::task_repository &tasks, std::size_t cache_size = 4096);
+    trip::response operator()(trip::request const &req, std::regex const &);
+};
+
 struct handle_task_list : trip::handler
 {
-    mongocxx::collection &coll;
-    handle_task_list(mongocxx::collection &coll);
+    storage::task_repository &tasks;
+    handle_task_list(storage::task_repository &tasks);
+    trip::response operator()(trip::request const &req, std::regex const &re);
+};
+
+struct handle_task_stats : trip::handler
+{
+    stats_registry const &stats;
+    handle_task_stats(stats_registry const &stats);
+    trip::response operator()(trip::request const &req, std::regex const &re);
+};
+
+struct handle_leaderboard : trip::handler
+{
+    stats_registry const &stats;
+    handle_leaderboard(stats_registry const &stats);
+    trip::response operator()(trip::request const &req, std::regex const &re);
+};
+
+struct handle_static : trip::handler
+{
+    static_assets const &assets;
+    handle_static(static_assets const &assets);
+    trip::response operator()(trip::request const &req, std::regex const &);
+};
+
+struct handle_metrics : trip::handler
+{
+    grader::grader_pool const *graders;
+    handle_metrics(grader::grader_pool const *graders = nullptr);
+    trip::response operator()(trip::request const &, std::regex const &);
+};
+
+struct handle_inflight : trip::handler
+{
+    inflight_registry const &inflight;
+    handle_inflight(inflight_registry const &inflight);
+    trip::response operator()(trip::request const &, std::regex const &);
+};
+
+struct handle_inflight_abort : trip::handler
+{
+    inflight_registry &inflight;
+    handle_inflight_abort(inflight_registry &inflight);
     trip::response operator()(trip::request const &req, std::regex const &re);
 };
 
@@ -15,6 +15,7 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
 #include <regex>
 
 #include "helper.hpp"
@@ -31,3 +32,69 @@ std::string convert_bool(std::string const &json_str)
     static std::regex re("\\\"(true|false)\\\"");
     return std::regex_replace(json_str, re, "$1");
 }
+
+
+std::uint64_t fnv1a_hash(std::string_view data)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+std::string to_hex(std::uint64_t value)
+{
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+
+std::string json_escape(std::string_view str)
+{
+    std::string out;
+    out.reserve(str.size());
+    append_json_escaped(out, str);
+    return out;
+}
+
+void append_json_escaped(std::string &out, std::string_view str)
+{
+    for (char c : str)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+                out += buf;
+            }
+            else
+            {
+                out += c;
+            }
+            break;
+        }
+    }
+}
@@ -23,6 +23,8 @@
 #include <chrono>
 #include <string>
 #include <sstream>
+#include <string_view>
+#include <cstdint>
 #include <ctime>
 
 template<typename Clock, typename Duration>
@@ -43,6 +45,10 @@ std::ostream &operator<<(std::ostream &stream, const std::chrono::time_point<Clo
 
 extern std::string convert_float(std::string const &json_str);
 extern std::string convert_bool(std::string const &json_str);
+extern std::uint64_t fnv1a_hash(std::string_view data);
+extern std::string to_hex(std::uint64_t value);
+extern std::string json_escape(std::string_view str);
+extern void append_json_escaped(std::string &out, std::string_view str);
 
 
 #endif // __HELPER_HPP__
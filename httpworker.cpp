@@ -15,43 +15,80 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
 #include <iostream>
 #include <iomanip>
 
 #include <boost/asio/ip/tcp.hpp>
 
+#include "allocation_stats.hpp"
 #include "global.hpp"
 #include "httpworker.hpp"
+#include "metrics.hpp"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+namespace
+{
+  std::atomic<std::uint64_t> next_worker_id{1};
+}
+
 http_worker::http_worker(
     tcp::acceptor &acceptor,
     const trip::router &router,
+    http_worker_config const &config,
     log_callback_t *logCallback)
     : acceptor_(acceptor)
     , router_(router)
+    , config_(config)
+    , id_(next_worker_id++)
     , log_callback_(logCallback)
 {
-  /* ... */
+  if (config_.inflight != nullptr)
+  {
+    slot_ = config_.inflight->add_worker();
+  }
+  // Headers every response carries. The response object lives as long as
+  // the worker, so they are formatted once instead of once per request.
+  response_.set(http::field::server, SERVER_INFO);
+  response_.set(http::field::access_control_allow_origin, "*");
+  response_.set(http::field::access_control_allow_headers, "x-csrf-token,authorization,content-type,accept,origin,x-requested-with,access-control-allow-origin");
+  response_.set(http::field::access_control_allow_methods, "GET,POST,OPTIONS");
+#ifndef NDEBUG
+  response_.set("X-Debug", "all");
+#endif
+  response_.set(http::field::vary, "Accept-Encoding");
 }
 
 void http_worker::start()
 {
   accept();
-  check_timeout();
+}
+
+void http_worker::set_state(worker_state state)
+{
+  if (slot_ != nullptr)
+  {
+    slot_->set(state);
+  }
 }
 
 void http_worker::accept()
 {
-  beast::error_code ec;
-  socket_.close(ec);
+  set_state(worker_state::idle);
+  stream_.close();
   buffer_.consume(buffer_.size());
+  busy_.store(false, std::memory_order_release);
+  if (!acceptor_.is_open())
+  {
+    // draining
+    return;
+  }
   acceptor_.async_accept(
-      socket_,
+      stream_.socket(),
       [this](beast::error_code ec)
       {
         if (ec)
@@ -60,7 +97,7 @@ void http_worker::accept()
         }
         else
         {
-          // req_timeout_.expires_after(Timeout);
+          busy_.store(true, std::memory_order_release);
           read_request();
         }
       });
@@ -68,96 +105,266 @@ void http_worker::accept()
 
 void http_worker::read_request()
 {
-  parser_.emplace();
+  encoding_ = content_encoding::identity;
+  cacheable_ = false;
+  trace_.reset();
+  trace_sampled_ = false;
+  cancel_.reset();
+  allocations_ = 0;
+  allocation_scope allocations(&allocations_);
+  set_state(worker_state::reading);
+  read_start_ = std::chrono::steady_clock::now();
+  // A parser cannot be reset, but the body string of the previous request
+  // can be handed to the new one, so its capacity is reused.
+  http::request<http::string_body> recycled;
+  if (parser_)
+  {
+    recycled.body() = std::move(parser_->get().body());
+    recycled.body().clear();
+  }
+  parser_.emplace(std::move(recycled));
+  parser_->header_limit(config_.header_limit);
+  parser_->body_limit(config_.body_limit);
+  stream_.expires_after(config_.header_timeout);
+  http::async_read_header(
+      stream_,
+      buffer_,
+      *parser_,
+      [this](beast::error_code ec, std::size_t)
+      {
+        allocation_scope allocations(&allocations_);
+        if (ec)
+        {
+          handle_read_error(ec);
+        }
+        else if (parser_->is_done())
+        {
+          stream_.expires_never();
+          process_request(parser_->get());
+        }
+        else
+        {
+          read_body();
+        }
+      });
+}
+
+void http_worker::read_body()
+{
+  stream_.expires_after(config_.body_timeout);
   http::async_read(
-      socket_,
+      stream_,
       buffer_,
       *parser_,
       [this](beast::error_code ec, std::size_t)
       {
+        allocation_scope allocations(&allocations_);
         if (ec)
         {
-          accept();
+          handle_read_error(ec);
         }
         else
         {
+          stream_.expires_never();
           process_request(parser_->get());
         }
       });
 }
 
+void http_worker::handle_read_error(beast::error_code ec)
+{
+  if (ec == beast::error::timeout)
+  {
+    if (parser_->is_header_done())
+    {
+      ++metrics().body_timeouts;
+    }
+    else
+    {
+      ++metrics().header_timeouts;
+    }
+    accept();
+  }
+  else if (ec == http::error::header_limit)
+  {
+    ++metrics().oversized_requests;
+    send_error_response(http::status::request_header_fields_too_large, "request header too large", "text/plain");
+  }
+  else if (ec == http::error::body_limit)
+  {
+    ++metrics().oversized_requests;
+    send_error_response(http::status::payload_too_large, "request body too large", "text/plain");
+  }
+  else
+  {
+    accept();
+  }
+}
+
 void http_worker::process_request(const http::request<http::string_body> &req)
 {
+  read_end_ = std::chrono::steady_clock::now();
+  if (slot_ != nullptr)
+  {
+    beast::error_code ec;
+    auto const remote = stream_.socket().remote_endpoint(ec);
+    slot_->set(worker_state::routing,
+               static_cast<std::uint16_t>(req.method()),
+               remote.address(),
+               std::string_view(req.target().data(), req.target().size()));
+  }
   if (log_callback_ != nullptr)
   {
     std::ostringstream ss;
-    ss << socket_.remote_endpoint().address().to_string() << ' '
+    ss << stream_.socket().remote_endpoint().address().to_string() << ' '
        << req.method() << ' '
        << req.target();
     (*log_callback_)(ss.str());
   }
-  trip::response response = router_.execute(req);
-  if (response.status == http::status::ok)
+  if (config_.compress_responses)
   {
-    send_response(response.body, response.mime_type);
+    auto const accept_encoding = req[http::field::accept_encoding];
+    encoding_ = negotiate_encoding(std::string_view(accept_encoding.data(), accept_encoding.size()));
   }
-  else
+  if (config_.limiter != nullptr)
   {
-    send_error_response(response.status, response.body, response.mime_type);
+    beast::error_code ec;
+    auto const remote = stream_.socket().remote_endpoint(ec);
+    std::string_view const target(req.target().data(), req.target().size());
+    auto const retry_after = config_.limiter->admit(
+        req.method(),
+        target.substr(0, target.find('?')),
+        ec ? std::string() : remote.address().to_string());
+    if (retry_after)
+    {
+      send_response(trip::response{
+          http::status::too_many_requests,
+          "{\"error\": \"too many requests\"}",
+          "application/json",
+          false,
+          {{http::field::retry_after, std::to_string(retry_after->count())}}});
+      return;
+    }
   }
+  trace_sampled_ = config_.tracer != nullptr && config_.tracer->sample();
+  if (config_.server_timing || trace_sampled_)
+  {
+    trace_.emplace(std::string(req.target()));
+    trace_->add("read", "", read_start_, read_end_);
+  }
+  trip::response response{http::status::internal_server_error, ""};
+  {
+    // The router runs synchronously on this thread, so the socket cannot
+    // be read asynchronously meanwhile; long running handlers poll the
+    // current cancellation token instead, which polls the socket.
+    cancel_.watch(stream_.socket().native_handle());
+    cancellation_scope cancellation(&cancel_);
+    trace_activation activation(trace_ ? &*trace_ : nullptr);
+    scoped_span span("route");
+    response = router_.execute(req);
+  }
+  if (cancel_.cancelled())
+  {
+    // nobody left to read the response
+    accept();
+    return;
+  }
+  cacheable_ = response.cacheable;
+  send_response(std::move(response));
 }
 
 void http_worker::send()
 {
-  response_->set(http::field::server, SERVER_INFO);
-  response_->set(http::field::access_control_allow_origin, "*");
-  response_->set(http::field::access_control_allow_headers, "x-csrf-token,authorization,content-type,accept,origin,x-requested-with,access-control-allow-origin");
-  response_->set(http::field::access_control_allow_methods, "GET,POST,OPTIONS");
-#ifndef NDEBUG
-  response_->set("X-Debug", "all");
-#endif
-  response_->prepare_payload();
-  serializer_.emplace(*response_);
+  set_state(worker_state::writing);
+  if (encoding_ != content_encoding::identity &&
+      response_.body().size() >= config_.compression_threshold &&
+      response_[http::field::content_encoding].empty())
+  {
+    trace_activation activation(trace_ ? &*trace_ : nullptr);
+    scoped_span span("compress");
+    if (cacheable_ && config_.response_cache != nullptr)
+    {
+      response_.body() = *config_.response_cache->get(response_.body(), encoding_);
+    }
+    else
+    {
+      response_.body() = compress(response_.body(), encoding_);
+    }
+    response_.set(http::field::content_encoding, to_string(encoding_));
+  }
+  if (config_.server_timing && trace_)
+  {
+    response_.set("Server-Timing", trace_->server_timing());
+  }
+  response_.prepare_payload();
+  serializer_.emplace(response_);
+  auto const write_start = std::chrono::steady_clock::now();
+  stream_.expires_after(config_.write_timeout);
   http::async_write(
-      socket_,
+      stream_,
       *serializer_,
-      [this](beast::error_code ec, std::size_t)
+      [this, write_start](beast::error_code ec, std::size_t)
       {
-        socket_.shutdown(tcp::socket::shutdown_send, ec);
-        serializer_.reset();
-        response_.reset();
+        {
+          allocation_scope allocations(&allocations_);
+          if (ec == beast::error::timeout)
+          {
+            ++metrics().write_timeouts;
+          }
+          if (trace_sampled_ && trace_)
+          {
+            trace_->add("write", "", write_start, std::chrono::steady_clock::now());
+            config_.tracer->write(*trace_, id_);
+          }
+          if (config_.capture != nullptr && parser_->is_done())
+          {
+            auto const &req = parser_->get();
+            config_.capture->record(
+                read_start_,
+                std::chrono::steady_clock::now() - read_end_,
+                static_cast<std::uint16_t>(req.method()),
+                static_cast<std::uint16_t>(response_.result_int()),
+                std::string_view(req.target().data(), req.target().size()),
+                req.body());
+          }
+          stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+          serializer_.reset();
+        }
+        metrics().request_allocations += allocations_;
+        ++metrics().allocation_counted_requests;
         accept();
       });
 }
 
-void http_worker::send_response(const std::string &body, const std::string &mimetype)
+void http_worker::reset_response(http::status status, std::string const &mimetype)
 {
-  response_.emplace();
-  response_->result(http::status::ok);
-  response_->set(http::field::content_type, mimetype);
-  response_->body() = body;
-  send();
+  // drop what the previous response added to the static headers
+  for (auto field : extra_fields_)
+  {
+    response_.erase(field);
+  }
+  extra_fields_.clear();
+  response_.erase(http::field::content_encoding);
+  response_.erase("Server-Timing");
+  response_.result(status);
+  response_.set(http::field::content_type, mimetype);
 }
 
-void http_worker::send_error_response(http::status status, const std::string &error, const std::string &mimetype)
+void http_worker::send_response(trip::response &&response)
 {
-  response_.emplace();
-  response_->result(status);
-  response_->set(http::field::content_type, mimetype);
-  response_->body() = error;
+  reset_response(response.status, response.mime_type);
+  for (auto const &[field, value] : response.headers)
+  {
+    response_.set(field, value);
+    extra_fields_.push_back(field);
+  }
+  response_.body() = std::move(response.body);
   send();
 }
 
-void http_worker::check_timeout()
+void http_worker::send_error_response(http::status status, std::string error, const std::string &mimetype)
 {
-  if (req_timeout_.expiry() <= std::chrono::steady_clock::now())
-  {
-    socket_.close();
-    req_timeout_.expires_at(std::chrono::steady_clock::time_point::max());
-  }
-  req_timeout_.async_wait(
-      [this](beast::error_code)
-      {
-        check_timeout();
-      });
+  reset_response(status, mimetype);
+  response_.body() = std::move(error);
+  send();
 }
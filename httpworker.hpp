@@ -18,10 +18,13 @@
 #ifndef __HTTP_WORKER_HPP__
 #define __HTTP_WORKER_HPP__
 
+#include <atomic>
 #include <string>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <optional>
+#include <vector>
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -29,10 +32,33 @@
 #include <boost/optional/optional.hpp>
 
 #include "trip/router.hpp"
+#include "cancellation.hpp"
+#include "compression.hpp"
+#include "inflight.hpp"
+#include "rate_limiter.hpp"
+#include "request_trace.hpp"
+#include "traffic_capture.hpp"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 
+struct http_worker_config
+{
+  std::chrono::seconds header_timeout{10};
+  std::chrono::seconds body_timeout{30};
+  std::chrono::seconds write_timeout{30};
+  std::uint32_t header_limit{8 * 1024};
+  std::uint64_t body_limit{256 * 1024};
+  bool compress_responses{true};
+  std::size_t compression_threshold{1024};
+  compression_cache *response_cache{nullptr};
+  bool server_timing{true};
+  trace_writer *tracer{nullptr};
+  traffic_capture *capture{nullptr};
+  request_limiter *limiter{nullptr};
+  inflight_registry *inflight{nullptr};
+};
+
 class http_worker
 {
   using tcp = boost::asio::ip::tcp;
@@ -45,31 +71,48 @@ public:
   http_worker(
       tcp::acceptor &acceptor,
       const trip::router &router,
+      http_worker_config const &config,
       log_callback_t *logFn = nullptr);
   void start();
-
-  static constexpr std::chrono::seconds Timeout{60};
+  // true from accepting a connection until its response is written;
+  // a worker whose acceptor was closed stops once it is idle
+  bool busy() const { return busy_.load(std::memory_order_acquire); }
 
 private:
   tcp::acceptor &acceptor_;
   trip::router const &router_;
-  tcp::socket socket_{acceptor_.get_executor()};
+  http_worker_config const &config_;
+  beast::tcp_stream stream_{acceptor_.get_executor()};
   beast::flat_buffer buffer_;
   std::optional<http::request_parser<http::string_body>> parser_;
-  boost::asio::basic_waitable_timer<std::chrono::steady_clock> req_timeout_{
-    acceptor_.get_executor(),
-    (std::chrono::steady_clock::time_point::max)()};
-  std::optional<http::response<http::string_body>> response_;
+  http::response<http::string_body> response_;
+  // fields the current response added to the static ones
+  std::vector<http::field> extra_fields_;
   std::optional<http::response_serializer<http::string_body>> serializer_;
+  content_encoding encoding_{content_encoding::identity};
+  bool cacheable_{false};
+  std::uint64_t id_;
+  std::chrono::steady_clock::time_point read_start_;
+  std::chrono::steady_clock::time_point read_end_;
+  std::optional<request_trace> trace_;
+  bool trace_sampled_{false};
+  cancellation_token cancel_;
+  // heap allocations made on behalf of the current request (debug builds)
+  std::uint64_t allocations_{0};
+  worker_slot *slot_{nullptr};
+  std::atomic<bool> busy_{false};
   log_callback_t *log_callback_;
 
+  void set_state(worker_state state);
   void accept();
   void read_request();
+  void read_body();
+  void handle_read_error(beast::error_code ec);
   void process_request(const http::request<http::string_body> &req);
   void send();
-  void send_response(const std::string &body, const std::string &mimetype);
-  void send_error_response(http::status status, const std::string &error, const std::string &mimetype);
-  void check_timeout();
+  void reset_response(http::status status, std::string const &mimetype);
+  void send_response(trip::response &&response);
+  void send_error_response(http::status status, std::string error, const std::string &mimetype);
 };
 
 #endif // __HTTP_WORKER_HPP__
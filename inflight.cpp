@@ -0,0 +1,256 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/asio/ip/address_v6.hpp>
+
+#include "inflight.hpp"
+
+namespace chrono = std::chrono;
+
+namespace
+{
+    std::int64_t now_nsecs()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<std::uint32_t> next_thread_index{1};
+}
+
+char const *to_string(worker_state state)
+{
+    switch (state)
+    {
+    case worker_state::idle:
+        return "idle";
+    case worker_state::reading:
+        return "reading";
+    case worker_state::routing:
+        return "routing";
+    case worker_state::writing:
+        return "writing";
+    }
+    return "unknown";
+}
+
+std::uint32_t thread_index()
+{
+    thread_local std::uint32_t const index = next_thread_index++;
+    return index;
+}
+
+void worker_slot::set(worker_state s)
+{
+    seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    state.store(static_cast<std::uint8_t>(s), std::memory_order_relaxed);
+    since.store(now_nsecs(), std::memory_order_relaxed);
+    seq.fetch_add(1, std::memory_order_release);
+}
+
+void worker_slot::set(worker_state s, std::uint16_t verb, boost::asio::ip::address const &client, std::string_view request_target)
+{
+    auto const v6 = client.is_v4()
+                        ? boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, client.to_v4())
+                        : client.to_v6();
+    auto const bytes = v6.to_bytes();
+    std::uint64_t words[2];
+    std::memcpy(words, bytes.data(), sizeof(words));
+    std::uint64_t text[TARGET_WORDS] = {};
+    std::memcpy(text, request_target.data(), std::min(request_target.size(), sizeof(text)));
+
+    seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    state.store(static_cast<std::uint8_t>(s), std::memory_order_relaxed);
+    since.store(now_nsecs(), std::memory_order_relaxed);
+    method.store(verb, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        remote[i].store(words[i], std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < TARGET_WORDS; ++i)
+    {
+        target[i].store(text[i], std::memory_order_relaxed);
+    }
+    seq.fetch_add(1, std::memory_order_release);
+}
+
+inflight_registry::inflight_registry(std::size_t max_workers, std::size_t max_executions)
+    : workers_(new worker_slot[max_workers])
+    , max_workers_(max_workers)
+    , executions_(new execution_slot[max_executions])
+    , max_executions_(max_executions)
+{
+}
+
+worker_slot *inflight_registry::add_worker()
+{
+    std::size_t const index = num_workers_++;
+    return index < max_workers_ ? &workers_[index] : nullptr;
+}
+
+execution_slot *inflight_registry::begin_execution(char const *task_oid_bytes, std::uint64_t script_hash)
+{
+    std::uint64_t const id = next_id_++;
+    for (std::size_t n = 0; n < max_executions_; ++n)
+    {
+        execution_slot &slot = executions_[(id + n) % max_executions_];
+        bool expected = false;
+        if (slot.claimed.load(std::memory_order_relaxed) ||
+            !slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            continue;
+        }
+        std::uint32_t task[3];
+        std::memcpy(task, task_oid_bytes, sizeof(task));
+        slot.abort_id.store(0, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            slot.task[i].store(task[i], std::memory_order_relaxed);
+        }
+        slot.script_hash.store(script_hash, std::memory_order_relaxed);
+        slot.started.store(now_nsecs(), std::memory_order_relaxed);
+        slot.thread.store(thread_index(), std::memory_order_relaxed);
+        slot.line.store(0, std::memory_order_relaxed);
+        slot.id.store(id, std::memory_order_release);
+        return &slot;
+    }
+    return nullptr;
+}
+
+void inflight_registry::end_execution(execution_slot *slot)
+{
+    slot->id.store(0, std::memory_order_release);
+    slot->claimed.store(false, std::memory_order_release);
+}
+
+bool inflight_registry::abort(std::uint64_t id)
+{
+    if (id == 0)
+    {
+        return false;
+    }
+    for (std::size_t n = 0; n < max_executions_; ++n)
+    {
+        execution_slot &slot = executions_[n];
+        if (slot.id.load(std::memory_order_acquire) == id)
+        {
+            // only the execution with this id compares equal, even if the
+            // slot has been reused in the meantime
+            slot.abort_id.store(id, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<worker_info> inflight_registry::workers() const
+{
+    std::vector<worker_info> result;
+    std::int64_t const now = now_nsecs();
+    std::size_t const n = std::min(num_workers_.load(), max_workers_);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        worker_slot const &slot = workers_[i];
+        for (int attempt = 0; attempt < 8; ++attempt)
+        {
+            std::uint64_t const seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+            {
+                continue;
+            }
+            worker_info info{};
+            info.index = i;
+            info.state = static_cast<worker_state>(slot.state.load(std::memory_order_relaxed));
+            info.elapsed = chrono::nanoseconds(now - slot.since.load(std::memory_order_relaxed));
+            info.method = slot.method.load(std::memory_order_relaxed);
+            std::uint64_t words[2];
+            for (std::size_t w = 0; w < 2; ++w)
+            {
+                words[w] = slot.remote[w].load(std::memory_order_relaxed);
+            }
+            char text[8 * worker_slot::TARGET_WORDS];
+            for (std::size_t w = 0; w < worker_slot::TARGET_WORDS; ++w)
+            {
+                std::uint64_t const word = slot.target[w].load(std::memory_order_relaxed);
+                std::memcpy(text + 8 * w, &word, sizeof(word));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq)
+            {
+                continue;
+            }
+            if (info.state != worker_state::idle)
+            {
+                boost::asio::ip::address_v6::bytes_type bytes;
+                std::memcpy(bytes.data(), words, sizeof(words));
+                boost::asio::ip::address_v6 const v6(bytes);
+                info.remote = v6.is_v4_mapped()
+                                  ? boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, v6).to_string()
+                                  : v6.to_string();
+                info.target.assign(text, strnlen(text, sizeof(text)));
+            }
+            result.push_back(std::move(info));
+            break;
+        }
+    }
+    return result;
+}
+
+std::vector<execution_info> inflight_registry::executions() const
+{
+    static char const hex[] = "0123456789abcdef";
+    std::vector<execution_info> result;
+    std::int64_t const now = now_nsecs();
+    for (std::size_t n = 0; n < max_executions_; ++n)
+    {
+        execution_slot const &slot = executions_[n];
+        std::uint64_t const id = slot.id.load(std::memory_order_acquire);
+        if (id == 0)
+        {
+            continue;
+        }
+        execution_info info{};
+        info.id = id;
+        std::uint32_t task[3];
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            task[i] = slot.task[i].load(std::memory_order_relaxed);
+        }
+        info.script_hash = slot.script_hash.load(std::memory_order_relaxed);
+        info.elapsed = chrono::nanoseconds(now - slot.started.load(std::memory_order_relaxed));
+        info.thread = slot.thread.load(std::memory_order_relaxed);
+        info.line = slot.line.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.id.load(std::memory_order_relaxed) != id)
+        {
+            continue; // finished while we were reading it
+        }
+        unsigned char bytes[sizeof(task)];
+        std::memcpy(bytes, task, sizeof(task));
+        for (unsigned char b : bytes)
+        {
+            info.task_id += hex[b >> 4];
+            info.task_id += hex[b & 0xf];
+        }
+        result.push_back(std::move(info));
+    }
+    return result;
+}
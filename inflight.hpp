@@ -0,0 +1,169 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INFLIGHT_HPP__
+#define __INFLIGHT_HPP__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/ip/address.hpp>
+
+// What the server is doing right now, for GET /admin/inflight. Workers and
+// executions publish their state into fixed slots with relaxed atomic
+// stores, so the request path never takes a lock; readers copy a slot and
+// discard the copy if the slot changed meanwhile.
+
+enum class worker_state : std::uint8_t
+{
+    idle,
+    reading,
+    routing,
+    writing
+};
+
+extern char const *to_string(worker_state state);
+
+// Small, stable number of the calling thread, for display.
+extern std::uint32_t thread_index();
+
+// Written by one worker only.
+struct worker_slot
+{
+    static constexpr std::size_t TARGET_WORDS = 8;
+
+    std::atomic<std::uint64_t> seq{0}; // odd while being written
+    std::atomic<std::uint8_t> state{0};
+    std::atomic<std::int64_t> since{0};
+    std::atomic<std::uint16_t> method{0};
+    std::array<std::atomic<std::uint64_t>, 2> remote{};
+    // the first 64 bytes of the request target
+    std::array<std::atomic<std::uint64_t>, TARGET_WORDS> target{};
+
+    void set(worker_state s);
+    void set(worker_state s, std::uint16_t verb, boost::asio::ip::address const &client, std::string_view request_target);
+};
+
+struct execution_slot
+{
+    std::atomic<bool> claimed{false};
+    std::atomic<std::uint64_t> id{0}; // 0 until the slot is filled
+    std::atomic<std::uint64_t> abort_id{0};
+    std::array<std::atomic<std::uint32_t>, 3> task{};
+    std::atomic<std::uint64_t> script_hash{0};
+    std::atomic<std::int64_t> started{0};
+    std::atomic<std::uint32_t> thread{0};
+    std::atomic<int> line{0};
+
+    // Called from the line callback of the running script. Returns true
+    // if an operator asked for this execution to be aborted.
+    bool record_line(int current_line)
+    {
+        line.store(current_line, std::memory_order_relaxed);
+        return abort_requested();
+    }
+    bool abort_requested() const
+    {
+        return abort_id.load(std::memory_order_relaxed) == id.load(std::memory_order_relaxed);
+    }
+};
+
+struct worker_info
+{
+    std::size_t index;
+    worker_state state;
+    std::chrono::nanoseconds elapsed;
+    std::uint16_t method;
+    std::string remote;
+    std::string target;
+};
+
+struct execution_info
+{
+    std::uint64_t id;
+    std::string task_id;
+    std::uint64_t script_hash;
+    std::chrono::nanoseconds elapsed;
+    std::uint32_t thread;
+    int line;
+};
+
+class inflight_registry
+{
+public:
+    explicit inflight_registry(std::size_t max_workers = 1024, std::size_t max_executions = 256);
+    inflight_registry(inflight_registry const &) = delete;
+    inflight_registry &operator=(inflight_registry const &) = delete;
+
+    // nullptr if there are more workers or executions than slots; those
+    // simply go untracked.
+    worker_slot *add_worker();
+    execution_slot *begin_execution(char const *task_oid_bytes, std::uint64_t script_hash);
+    void end_execution(execution_slot *slot);
+
+    // Asks the execution to stop at its next line. Returns false if no
+    // execution with this id is running.
+    bool abort(std::uint64_t id);
+
+    std::vector<worker_info> workers() const;
+    std::vector<execution_info> executions() const;
+
+private:
+    std::unique_ptr<worker_slot[]> workers_;
+    std::size_t const max_workers_;
+    std::atomic<std::size_t> num_workers_{0};
+    std::unique_ptr<execution_slot[]> executions_;
+    std::size_t const max_executions_;
+    std::atomic<std::uint64_t> next_id_{1};
+};
+
+// Claims an execution slot for its lifetime.
+class inflight_execution
+{
+public:
+    inflight_execution(inflight_registry *registry, char const *task_oid_bytes, std::uint64_t script_hash)
+        : registry_(registry)
+        , slot_(registry != nullptr ? registry->begin_execution(task_oid_bytes, script_hash) : nullptr)
+    {
+    }
+    ~inflight_execution()
+    {
+        if (slot_ != nullptr)
+        {
+            registry_->end_execution(slot_);
+        }
+    }
+    inflight_execution(inflight_execution const &) = delete;
+    inflight_execution &operator=(inflight_execution const &) = delete;
+
+    execution_slot *slot() const
+    {
+        return slot_;
+    }
+
+private:
+    inflight_registry *registry_;
+    execution_slot *slot_;
+};
+
+#endif // __INFLIGHT_HPP__
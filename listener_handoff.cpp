@@ -0,0 +1,185 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "listener_handoff.hpp"
+
+namespace net = boost::asio;
+using local = net::local::stream_protocol;
+
+namespace
+{
+    // how long a successor waits for a running server to hand over
+    constexpr timeval HANDOFF_TIMEOUT{5, 0};
+
+    sockaddr_un unix_address(std::string const &path)
+    {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            throw std::invalid_argument("handoff socket path too long: " + path);
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+}
+
+int listener_handoff::take_over(std::string const &path, int *predecessor)
+{
+    if (predecessor != nullptr)
+    {
+        *predecessor = -1;
+    }
+    sockaddr_un const addr = unix_address(path);
+    int const fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    // a wedged predecessor must not hang the startup: both connect() (with
+    // a full backlog) and recvmsg() give up after the timeout
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+    if (::connect(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) < 0)
+    {
+        // no predecessor, or a stale socket file it left behind
+        ::close(fd);
+        return -1;
+    }
+    char byte;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t const n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    int const recv_errno = errno;
+    if (n < 0 && (recv_errno == EAGAIN || recv_errno == EWOULDBLOCK))
+    {
+        ::close(fd);
+        throw std::runtime_error("the server at " + path + " did not hand over its listener in time");
+    }
+    cmsghdr const *cmsg = n == 1 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        ::close(fd);
+        throw std::runtime_error("no listening socket received from " + path);
+    }
+    int listener;
+    std::memcpy(&listener, CMSG_DATA(cmsg), sizeof(listener));
+    if (predecessor != nullptr)
+    {
+        // waiting for the predecessor to exit takes as long as its drain
+        timeval const no_timeout{0, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &no_timeout, sizeof(no_timeout));
+        *predecessor = fd;
+    }
+    else
+    {
+        ::close(fd);
+    }
+    return listener;
+}
+
+listener_handoff::listener_handoff(net::io_context &ioc, std::string path, int listener, std::function<void()> on_handoff)
+    : path_(std::move(path))
+    , listener_(listener)
+    , on_handoff_(std::move(on_handoff))
+    , acceptor_(ioc)
+    , peer_(ioc)
+{
+    unix_address(path_); // validate the length
+    ::unlink(path_.c_str());
+    acceptor_.open(local());
+    acceptor_.bind(local::endpoint(path_));
+    acceptor_.listen(1);
+}
+
+listener_handoff::~listener_handoff()
+{
+    if (!handed_off_)
+    {
+        ::unlink(path_.c_str());
+    }
+}
+
+void listener_handoff::start()
+{
+    accept();
+}
+
+void listener_handoff::stop()
+{
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+}
+
+void listener_handoff::accept()
+{
+    peer_ = local::socket(acceptor_.get_executor());
+    acceptor_.async_accept(
+        peer_,
+        [this](boost::system::error_code ec)
+        {
+            if (ec)
+            {
+                if (ec != net::error::operation_aborted)
+                {
+                    accept();
+                }
+                return;
+            }
+            char byte = 0;
+            iovec iov{&byte, 1};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), &listener_, sizeof(listener_));
+            // one byte into an empty socket buffer: this does not block
+            if (::sendmsg(peer_.native_handle(), &msg, MSG_NOSIGNAL) != 1)
+            {
+                peer_.close(ec);
+                accept();
+                return;
+            }
+            // peer_ stays open: the successor learns from its EOF that
+            // this process, and its last statistics snapshot, are done
+            handed_off_ = true;
+            acceptor_.close(ec);
+            on_handoff_();
+        });
+}
@@ -0,0 +1,66 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LISTENER_HANDOFF_HPP__
+#define __LISTENER_HANDOFF_HPP__
+
+#include <functional>
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+// Passes the listening socket of a running server to the one replacing
+// it, over a Unix domain socket. Both processes then share one socket and
+// its accept backlog, so a restart neither refuses nor resets a single
+// connection: the new process accepts while the old one drains.
+class listener_handoff
+{
+public:
+    // Asks the process serving path for its listening socket. Returns -1
+    // if nobody serves path; throws if the answer carries no socket or
+    // does not arrive within a few seconds. If predecessor is given, it
+    // receives the connection to that process, which reaches EOF once the
+    // process has exited, or -1.
+    static int take_over(std::string const &path, int *predecessor = nullptr);
+
+    // Serves listener to the next process that asks for it, then calls
+    // on_handoff on one of the io_context's threads. The connection to the
+    // successor stays open until this process exits.
+    listener_handoff(boost::asio::io_context &ioc, std::string path, int listener, std::function<void()> on_handoff);
+    // removes path unless the listener was handed off; the successor
+    // serves it by then
+    ~listener_handoff();
+    listener_handoff(listener_handoff const &) = delete;
+    listener_handoff &operator=(listener_handoff const &) = delete;
+
+    void start();
+    // Stops serving the listener, e.g. because it is about to be closed.
+    void stop();
+
+private:
+    std::string path_;
+    int listener_;
+    std::function<void()> on_handoff_;
+    boost::asio::local::stream_protocol::acceptor acceptor_;
+    boost::asio::local::stream_protocol::socket peer_;
+    bool handed_off_{false};
+
+    void accept();
+};
+
+#endif // __LISTENER_HANDOFF_HPP__
@@ -0,0 +1,120 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+
+#include <unistd.h>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+
+#include "log_writer.hpp"
+
+namespace
+{
+    void write_all(int fd, std::string const &data)
+    {
+        std::size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t const n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                break;
+            }
+            written += static_cast<std::size_t>(n);
+        }
+    }
+}
+
+#ifdef BOOST_ASIO_HAS_IO_URING_AS_DEFAULT
+
+log_writer::log_writer(boost::asio::io_context &ioc, int fd)
+    : out_(ioc, ::dup(fd))
+{
+}
+
+log_writer::~log_writer()
+{
+    // whatever the I/O context did not get to any more
+    std::lock_guard<std::mutex> lock(mtx_);
+    write_all(out_.native_handle(), pending_);
+}
+
+void log_writer::write(std::string line)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_ += line;
+    if (!busy_)
+    {
+        start_write();
+    }
+}
+
+// called with mtx_ held
+void log_writer::start_write()
+{
+    busy_ = true;
+    writing_.swap(pending_);
+    boost::asio::async_write(
+        out_,
+        boost::asio::buffer(writing_),
+        [this](boost::system::error_code const &, std::size_t)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            writing_.clear();
+            if (pending_.empty())
+            {
+                busy_ = false;
+            }
+            else
+            {
+                start_write();
+            }
+        });
+}
+
+char const *log_writer::backend()
+{
+    return "io_uring";
+}
+
+#else
+
+log_writer::log_writer(boost::asio::io_context &, int fd)
+    : fd_(fd)
+{
+}
+
+log_writer::~log_writer() = default;
+
+void log_writer::write(std::string line)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    write_all(fd_, line);
+}
+
+char const *log_writer::backend()
+{
+    return "epoll";
+}
+
+#endif
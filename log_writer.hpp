@@ -0,0 +1,59 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOG_WRITER_HPP__
+#define __LOG_WRITER_HPP__
+
+#include <mutex>
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+// Appends log lines to a file descriptor, stdout by default. With the
+// io_uring backend (cmake -DWITH_IO_URING=ON) the writes are submitted on
+// the I/O context, so a slow terminal or disk does not stall a thread
+// that is serving requests. epoll cannot wait on regular files, so
+// without io_uring the lines are written synchronously.
+class log_writer
+{
+public:
+    log_writer(boost::asio::io_context &ioc, int fd);
+    ~log_writer();
+    log_writer(log_writer const &) = delete;
+    log_writer &operator=(log_writer const &) = delete;
+
+    void write(std::string line);
+
+    // Name of the reactor Boost.Asio was built with, for the startup banner.
+    static char const *backend();
+
+private:
+    std::mutex mtx_;
+#ifdef BOOST_ASIO_HAS_IO_URING_AS_DEFAULT
+    boost::asio::posix::stream_descriptor out_;
+    std::string pending_;
+    std::string writing_;
+    bool busy_{false};
+
+    void start_write();
+#else
+    int fd_;
+#endif
+};
+
+#endif // __LOG_WRITER_HPP__
@@ -0,0 +1,83 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LRU_CACHE_HPP__
+#define __LRU_CACHE_HPP__
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Thread-safe cache holding at most `capacity` entries, evicting the
+// least recently used one first.
+template <typename Key, typename Value>
+class lru_cache
+{
+public:
+    explicit lru_cache(std::size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+    lru_cache(lru_cache const &) = delete;
+    lru_cache &operator=(lru_cache const &) = delete;
+
+    std::optional<Value> get(Key const &key)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            return std::nullopt;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    void put(Key const &key, Value value)
+    {
+        if (capacity_ == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            it->second->second = std::move(value);
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        if (entries_.size() >= capacity_)
+        {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_.emplace(key, entries_.begin());
+    }
+
+private:
+    std::size_t const capacity_;
+    std::list<std::pair<Key, Value>> entries_;
+    std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator> index_;
+    std::mutex mtx_;
+};
+
+#endif // __LRU_CACHE_HPP__
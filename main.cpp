@@ -15,6 +15,8 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <memory>
@@ -23,24 +25,46 @@
 #include <vector>
 #include <thread>
 #include <mutex>
-#include <memory>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+#include <sys/socket.h>
+#include <unistd.h>
 
-#include <boost/lexical_cast.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
 #include <boost/regex.hpp>
 
 #include <angelscript.h>
 
 #include <mongocxx/instance.hpp>
 #include <mongocxx/uri.hpp>
-#include <mongocxx/stdx.hpp>
-#include <mongocxx/client.hpp>
 
 #include "global.hpp"
 #include "helper.hpp"
 #include "httpworker.hpp"
+#include "listener_handoff.hpp"
+#include "log_writer.hpp"
+#include "rate_limiter.hpp"
+#include "request_trace.hpp"
+#include "script_scheduler.hpp"
+#include "static_assets.hpp"
+#include "traffic_capture.hpp"
+#include "task_stats.hpp"
 #include "trip/router.hpp"
 #include "handlers/handlers.hpp"
+#include "grader/grader_pool.hpp"
+#include "grader/grader_server.hpp"
+#include "storage/caching_task_repository.hpp"
+#include "storage/coalescing_task_repository.hpp"
+#include "storage/indexed_task_repository.hpp"
+#include "storage/memory_task_repository.hpp"
+#include "storage/mongo_task_repository.hpp"
+#include "storage/submission_journal.hpp"
+#include "storage/task_import.hpp"
+#include "storage/task_pack.hpp"
 
 #ifndef NDEBUG
 const char *DEFAULT_HOST = "0.0.0.0";
@@ -51,6 +75,7 @@ constexpr uint16_t DEFAULT_PORT = 31337U;
 
 using tcp = boost::asio::ip::tcp;
 namespace net = boost::asio;
+namespace po = boost::program_options;
 
 void hello()
 {
@@ -58,13 +83,13 @@ void hello()
             << std::endl;
 }
 
-void usage()
+void usage(po::options_description const &desc)
 {
   std::cout << "Usage:" << std::endl
-            << "  dascript-webservice [<ip> <port> <num_workers> <num_threads>]" << std::endl
+            << "  dascript-webservice [<ip> <port> <num_workers> <num_threads>] [options]" << std::endl
             << std::endl
             << "for example:" << std::endl
-            << "  dascript-webservice 0.0.0.0 8081 2 2" << std::endl
+            << "  dascript-webservice 0.0.0.0 8081 2 2 --header-timeout 5" << std::endl
             << std::endl
             << "or just:" << std::endl
             << "  dascript-webservice" << std::endl
@@ -72,68 +97,603 @@ void usage()
             << "to use the defaults: " << DEFAULT_HOST << " " << DEFAULT_PORT << " N N" << std::endl
             << "where N stands for the number of CPU cores ("
             << std::thread::hardware_concurrency() << ")." << std::endl
-            << std::endl;
+            << std::endl
+            << desc << std::endl;
 }
 
-int main(int argc, const char *argv[])
+// Sends the requests every visitor starts with through the router before
+// the server takes traffic, so that the database connections are open and
+// the compressed task lists are cached when the first client arrives.
+void warm_up(trip::router const &router, http_worker_config const &config)
 {
-  hello();
-  if (!(argc == 1 || argc == 5))
+  content_encoding const encoding = negotiate_encoding("gzip, deflate, br");
+  for (char const *target : {"/tasks/current", "/tasks/all", "/tasks/archived"})
   {
-    usage();
-    return EXIT_FAILURE;
+    trip::response const response = router.execute(trip::request{http::verb::get, target, 11});
+    if (response.cacheable &&
+        config.compress_responses &&
+        config.response_cache != nullptr &&
+        encoding != content_encoding::identity &&
+        response.body.size() >= config.compression_threshold)
+    {
+      config.response_cache->get(response.body, encoding);
+    }
   }
+}
 
-  net::ip::address host = net::ip::make_address(DEFAULT_HOST);
+int main(int argc, const char *argv[])
+{
+  hello();
+
+  std::string host_str;
   uint16_t port = DEFAULT_PORT;
   unsigned int num_workers = std::thread::hardware_concurrency();
   unsigned int num_threads = num_workers;
-  if (argc == 5)
+  unsigned int header_timeout;
+  unsigned int body_timeout;
+  unsigned int write_timeout;
+  std::size_t compression_cache_size = 16 * 1024 * 1024;
+  std::string html_root;
+  std::string storage_backend;
+  std::string mongodb_uri;
+  std::string mongodb_database;
+  std::string mongodb_collection;
+  std::string task_file;
+  bool journal_enabled;
+  std::string journal_collection;
+  unsigned int journal_interval;
+  storage::submission_journal_config journal_config;
+  std::string stats_file;
+  unsigned int stats_interval;
+  unsigned int task_index_refresh;
+  std::size_t compile_cache_size;
+  std::string trace_file;
+  unsigned int trace_every;
+  std::string capture_file;
+  uint16_t grader_port;
+  unsigned int grader_executors = std::thread::hardware_concurrency();
+  std::string grader_addresses;
+  unsigned int grader_timeout;
+  unsigned int grader_health_interval;
+  unsigned int grader_task_cache;
+  grader::grader_pool_config grader_config;
+  std::vector<std::string> rate_limits;
+  unsigned int scheduler_threads = std::thread::hardware_concurrency();
+  unsigned int time_slice;
+  std::string email_limit;
+  uint16_t admin_port;
+  unsigned int drain_timeout;
+  std::string handoff_socket;
+  http_worker_config worker_config;
+
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "show this help")
+    ("host", po::value<std::string>(&host_str)->default_value(DEFAULT_HOST), "IP address to listen on")
+    ("port", po::value<uint16_t>(&port)->default_value(DEFAULT_PORT), "port to listen on")
+    ("workers", po::value<unsigned int>(&num_workers)->default_value(num_workers), "number of HTTP workers")
+    ("threads", po::value<unsigned int>(&num_threads)->default_value(num_threads), "number of I/O threads")
+    ("header-timeout", po::value<unsigned int>(&header_timeout)->default_value(static_cast<unsigned int>(worker_config.header_timeout.count())), "seconds a client may take to send the request header")
+    ("body-timeout", po::value<unsigned int>(&body_timeout)->default_value(static_cast<unsigned int>(worker_config.body_timeout.count())), "seconds a client may take to send the request body")
+    ("write-timeout", po::value<unsigned int>(&write_timeout)->default_value(static_cast<unsigned int>(worker_config.write_timeout.count())), "seconds a client may take to receive the response")
+    ("header-limit", po::value<std::uint32_t>(&worker_config.header_limit)->default_value(worker_config.header_limit), "maximum size of the request header in bytes")
+    ("body-limit", po::value<std::uint64_t>(&worker_config.body_limit)->default_value(worker_config.body_limit), "maximum size of the request body in bytes")
+    ("compress", po::value<bool>(&worker_config.compress_responses)->default_value(worker_config.compress_responses), "compress responses if the client accepts it")
+    ("compression-threshold", po::value<std::size_t>(&worker_config.compression_threshold)->default_value(worker_config.compression_threshold), "minimum body size in bytes for compression")
+    ("compression-cache-size", po::value<std::size_t>(&compression_cache_size)->default_value(compression_cache_size), "bytes reserved for precompressed responses")
+    ("html-root", po::value<std::string>(&html_root)->default_value("html"), "directory with the front-end files to serve (empty to disable)")
+    ("storage", po::value<std::string>(&storage_backend)->default_value("mongodb"), "where tasks are read from: mongodb, memory or taskpack")
+    ("mongodb-uri", po::value<std::string>(&mongodb_uri)->default_value("mongodb://192.168.0.181:27017"), "MongoDB connection string")
+    ("mongodb-database", po::value<std::string>(&mongodb_database)->default_value("tasks"), "MongoDB database holding the tasks")
+    ("mongodb-collection", po::value<std::string>(&mongodb_collection)->default_value("test"), "MongoDB collection holding the tasks")
+    ("task-index-refresh", po::value<unsigned int>(&task_index_refresh)->default_value(60), "seconds between rebuilds of the index that answers lookups of unknown task ids without a query (storage mongodb only, 0 to disable)")
+    ("task-file", po::value<std::string>(&task_file), "JSON/BSON export (storage memory) or task pack (storage taskpack) to read the tasks from")
+    ("journal", po::value<bool>(&journal_enabled)->default_value(true), "record submissions and their verdicts")
+    ("journal-collection", po::value<std::string>(&journal_collection)->default_value("submissions"), "MongoDB collection for the submission journal (storage mongodb only)")
+    ("journal-file", po::value<std::string>(&journal_config.fallback_path)->default_value("submissions.jsonl"), "file the journal appends to while the database is unreachable")
+    ("journal-capacity", po::value<std::size_t>(&journal_config.capacity)->default_value(journal_config.capacity), "maximum number of queued submissions before records are dropped")
+    ("journal-batch", po::value<std::size_t>(&journal_config.batch_size)->default_value(journal_config.batch_size), "number of submissions written at once")
+    ("journal-interval", po::value<unsigned int>(&journal_interval)->default_value(static_cast<unsigned int>(journal_config.flush_interval.count())), "milliseconds between journal flushes")
+    ("stats-file", po::value<std::string>(&stats_file)->default_value("stats.json"), "file to snapshot task statistics and leaderboards to (empty to disable)")
+    ("stats-interval", po::value<unsigned int>(&stats_interval)->default_value(60), "seconds between statistics snapshots")
+    ("compile-cache-size", po::value<std::size_t>(&compile_cache_size)->default_value(4096), "number of compile results kept for POST /compile")
+    ("server-timing", po::value<bool>(&worker_config.server_timing)->default_value(worker_config.server_timing), "add a Server-Timing header with the request's spans to every response")
+    ("trace-file", po::value<std::string>(&trace_file), "file to write sampled request traces to in Chrome trace event format")
+    ("trace-every", po::value<unsigned int>(&trace_every)->default_value(100), "write the trace of every n-th request")
+    ("capture-file", po::value<std::string>(&capture_file), "record all requests to this file for the replay tool (email addresses are redacted)")
+    ("grader-port", po::value<uint16_t>(&grader_port)->default_value(0), "run as a grader: execute scripts for front nodes on this port instead of serving HTTP")
+    ("grader-executors", po::value<unsigned int>(&grader_executors)->default_value(grader_executors), "number of scripts a grader runs at once")
+    ("graders", po::value<std::string>(&grader_addresses), "comma-separated host:port list of graders to run scripts on instead of locally")
+    ("grader-timeout", po::value<unsigned int>(&grader_timeout)->default_value(static_cast<unsigned int>(grader_config.execute_deadline.count())), "milliseconds a grader may spend on one submission, all tests and queueing included, before it gives up on the script")
+    ("grader-task-cache", po::value<unsigned int>(&grader_task_cache)->default_value(60), "seconds a grader keeps a task before reading it again (0 to disable)")
+    ("grader-health-interval", po::value<unsigned int>(&grader_health_interval)->default_value(static_cast<unsigned int>(grader_config.health_interval.count())), "milliseconds between grader health checks")
+    ("grader-max-inflight", po::value<unsigned int>(&grader_config.max_inflight)->default_value(grader_config.max_inflight), "executions in flight to one grader before tasks spill over to the next")
+    ("rate-limit", po::value<std::vector<std::string>>(&rate_limits)->multitoken(), "per client address limits as \"[<METHOD> ]<path regex>=<requests per second>[:<burst>]\", e.g. \"POST /execute=2:20\"; the first matching rule applies. Off by default: the key is the TCP peer address, so a school behind one NAT shares a single bucket, and behind a reverse proxy all clients share the proxy's")
+    ("email-limit", po::value<std::string>(&email_limit)->default_value("0.5:10"), "limit of submissions per email as <per second>[:<burst>] (empty to disable); keyed by the submitted address, so clients sharing a network do not share it")
+    ("scheduler-threads", po::value<unsigned int>(&scheduler_threads)->default_value(scheduler_threads), "threads running scripts in time slices (0 to run each script on the thread that received it)")
+    ("time-slice", po::value<unsigned int>(&time_slice)->default_value(10), "milliseconds a script runs before it yields to the next one")
+    ("admin-port", po::value<uint16_t>(&admin_port)->default_value(0), "port on 127.0.0.1 serving /admin/inflight and /metrics (0 to disable)")
+    ("drain-timeout", po::value<unsigned int>(&drain_timeout)->default_value(60), "seconds requests in progress may take to finish after SIGTERM/SIGINT (a second signal stops at once); the wall ceiling of a script applies per test, so a submission with many tests can still be cut off")
+    ("handoff-socket", po::value<std::string>(&handoff_socket), "Unix socket to take the listener over from a running server, which then drains, and to hand it to the next one");
+  po::positional_options_description positional;
+  positional.add("host", 1).add("port", 1).add("workers", 1).add("threads", 1);
+
+  net::ip::address host;
+  try
+  {
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+    if (vm.count("help"))
+    {
+      usage(desc);
+      return EXIT_SUCCESS;
+    }
+    host = net::ip::make_address(host_str);
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << e.what() << std::endl
+              << std::endl;
+    usage(desc);
+    return EXIT_FAILURE;
+  }
+  num_workers = std::max(1U, num_workers);
+  num_threads = std::max(1U, num_threads);
+  worker_config.header_timeout = std::chrono::seconds(header_timeout);
+  worker_config.body_timeout = std::chrono::seconds(body_timeout);
+  worker_config.write_timeout = std::chrono::seconds(write_timeout);
+  grader_config.execute_deadline = std::chrono::milliseconds(std::max(1000U, grader_timeout));
+  grader_config.health_interval = std::chrono::milliseconds(std::max(100U, grader_health_interval));
+  journal_config.flush_interval = std::chrono::milliseconds(journal_interval);
+  journal_config.batch_size = std::max<std::size_t>(1U, journal_config.batch_size);
+  compression_cache response_cache{compression_cache_size};
+  worker_config.response_cache = &response_cache;
+  std::unique_ptr<trace_writer> tracer;
+  if (!trace_file.empty())
+  {
+    tracer = std::make_unique<trace_writer>(trace_file, trace_every);
+    worker_config.tracer = tracer.get();
+  }
+  std::unique_ptr<traffic_capture> capture;
+  if (!capture_file.empty())
   {
     try
     {
-      host = net::ip::make_address(argv[1]);
-      port = boost::lexical_cast<uint16_t>(argv[2]);
-      num_workers = std::max(1U, boost::lexical_cast<unsigned int>(argv[3]));
-      num_threads = std::max(1U, boost::lexical_cast<unsigned int>(argv[4]));
+      capture = std::make_unique<traffic_capture>(capture_file);
     }
-    catch (boost::exception const &)
+    catch (std::exception const &e)
     {
-      usage();
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    worker_config.capture = capture.get();
+  }
+
+  request_limiter ip_limiter;
+  std::unique_ptr<rate_limiter> email_limiter;
+  try
+  {
+    for (auto const &spec : rate_limits)
+    {
+      if (!spec.empty())
+      {
+        ip_limiter.add_rule(spec);
+      }
+    }
+    if (!email_limit.empty())
+    {
+      email_limiter = std::make_unique<rate_limiter>(parse_rate_limit(email_limit));
+    }
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!ip_limiter.empty())
+  {
+    worker_config.limiter = &ip_limiter;
+  }
+
+  static_assets assets;
+  if (!html_root.empty())
+  {
+    try
+    {
+      assets.load(html_root);
+      std::cout << assets.size() << " static files loaded from " << html_root << std::endl;
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << "Cannot load static files: " << e.what() << std::endl;
       return EXIT_FAILURE;
     }
   }
 
   mongocxx::instance instance{};
-  auto client = mongocxx::client{mongocxx::uri{"mongodb://192.168.0.181:27017"}};
-  mongocxx::database db = client["tasks"];
-  mongocxx::collection test_task_coll = db["test"];
+  std::unique_ptr<storage::task_repository> tasks;
+  try
+  {
+    if (storage_backend == "mongodb")
+    {
+      // a new task opening makes hundreds of clients ask for it at once
+      tasks = std::make_unique<storage::coalescing_task_repository>(
+          std::make_unique<storage::mongo_task_repository>(mongocxx::uri{mongodb_uri}, mongodb_database, mongodb_collection));
+      if (task_index_refresh > 0)
+      {
+        tasks = std::make_unique<storage::indexed_task_repository>(std::move(tasks), std::chrono::seconds(task_index_refresh));
+      }
+    }
+    else if (storage_backend == "memory")
+    {
+      auto repo = std::make_unique<storage::memory_task_repository>(storage::read_task_export(task_file));
+      std::cout << repo->size() << " tasks loaded from " << task_file << std::endl;
+      tasks = std::move(repo);
+    }
+    else if (storage_backend == "taskpack")
+    {
+      auto repo = std::make_unique<storage::task_pack_repository>(task_file);
+      std::cout << repo->size() << " tasks mapped from " << task_file << std::endl;
+      tasks = std::move(repo);
+    }
+    else
+    {
+      std::cerr << "Unknown storage backend: " << storage_backend << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "Cannot open task storage: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<script_scheduler> scheduler;
+  if (scheduler_threads > 0)
+  {
+    scheduler = std::make_unique<script_scheduler>(scheduler_threads, std::chrono::milliseconds(time_slice));
+  }
+
+  if (grader_port != 0)
+  {
+    if (grader_task_cache > 0)
+    {
+      tasks = std::make_unique<storage::caching_task_repository>(std::move(tasks), 1024, std::chrono::seconds(grader_task_cache));
+    }
+    boost::asio::io_context ioc;
+    grader::grader_server grader{ioc, {host, grader_port}, *tasks, grader_executors, scheduler.get()};
+    grader.start();
+    // like the HTTP server: the first signal drains, the second one stops at once
+    net::steady_timer drain_timer{ioc};
+    std::chrono::steady_clock::time_point drain_deadline;
+    std::function<void()> wait_for_executions = [&]
+    {
+      drain_timer.expires_after(std::chrono::milliseconds(50));
+      drain_timer.async_wait(
+          [&](boost::system::error_code const &ec)
+          {
+            if (ec)
+            {
+              return;
+            }
+            if (grader.busy() && std::chrono::steady_clock::now() < drain_deadline)
+            {
+              wait_for_executions();
+            }
+            else
+            {
+              ioc.stop();
+            }
+          });
+    };
+    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait(
+        [&](boost::system::error_code const &ec, int)
+        {
+          if (ec)
+          {
+            return;
+          }
+          drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(drain_timeout);
+          grader.drain();
+          std::cout << "draining ..." << std::endl;
+          wait_for_executions();
+          signals.async_wait(
+              [&ioc](boost::system::error_code const &ec, int)
+              {
+                if (!ec)
+                {
+                  ioc.stop();
+                }
+              });
+        });
+    std::vector<std::thread> threads;
+    for (auto i = 1U; i < num_threads; ++i)
+    {
+      threads.emplace_back(
+          [&ioc]
+          {
+            ioc.run();
+          });
+    }
+    std::cout << "grader with " << std::max(1U, grader_executors) << " executors listening on " << host << ':' << grader_port << " ..." << std::endl;
+    ioc.run();
+    for (auto &t : threads)
+    {
+      t.join();
+    }
+    return EXIT_SUCCESS;
+  }
+
+  std::unique_ptr<grader::grader_pool> graders;
+  if (!grader_addresses.empty())
+  {
+    std::vector<std::string> addresses;
+    std::istringstream list(grader_addresses);
+    for (std::string address; std::getline(list, address, ',');)
+    {
+      if (!address.empty())
+      {
+        addresses.push_back(address);
+      }
+    }
+    try
+    {
+      graders = std::make_unique<grader::grader_pool>(addresses, grader_config);
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "scripts are executed on " << addresses.size() << " grader(s)" << std::endl;
+  }
+
+  std::unique_ptr<storage::submission_journal> journal;
+  if (journal_enabled)
+  {
+    std::optional<mongocxx::uri> journal_uri;
+    if (storage_backend == "mongodb")
+    {
+      journal_uri.emplace(mongodb_uri);
+    }
+    journal = std::make_unique<storage::submission_journal>(journal_uri, mongodb_database, journal_collection, journal_config);
+  }
+
+  stats_registry stats;
 
   boost::asio::io_context ioc;
-  tcp::acceptor acceptor{ioc, {host, port}};
+  // opened once everything is warmed up
+  tcp::acceptor acceptor{ioc};
+
+  net::steady_timer stats_timer{ioc};
+  std::function<void()> save_stats = [&]
+  {
+    try
+    {
+      stats.save(stats_file);
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << "Cannot save statistics to " << stats_file << ": " << e.what() << std::endl;
+    }
+  };
+  std::function<void()> schedule_stats_snapshot = [&]
+  {
+    stats_timer.expires_after(std::chrono::seconds(std::max(1U, stats_interval)));
+    stats_timer.async_wait(
+        [&](boost::system::error_code const &ec)
+        {
+          if (!ec)
+          {
+            save_stats();
+            schedule_stats_snapshot();
+          }
+        });
+  };
+  // After a handoff the predecessor records verdicts until it exits and
+  // then writes its last snapshot: the statistics are loaded only then,
+  // and snapshots start only then, so that they never replace its own.
+  bool stats_loaded = false;
+  std::function<void()> load_stats = [&]
+  {
+    if (stats_file.empty())
+    {
+      return;
+    }
+    if (std::filesystem::exists(stats_file))
+    {
+      try
+      {
+        stats.load(stats_file);
+      }
+      catch (std::exception const &e)
+      {
+        std::cerr << "Cannot load statistics from " << stats_file << ": " << e.what() << std::endl;
+      }
+    }
+    stats_loaded = true;
+    schedule_stats_snapshot();
+  };
 
-  std::mutex log_mtx;
-  http_worker::log_callback_t logger = [&log_mtx](const std::string &msg)
+  log_writer log_out{ioc, STDOUT_FILENO};
+  http_worker::log_callback_t logger = [&log_out](const std::string &msg)
   {
-    std::lock_guard<std::mutex> lock(log_mtx);
-    std::cout << std::chrono::system_clock::now() << ' '
-              << msg << std::endl;
+    std::ostringstream line;
+    line << std::chrono::system_clock::now() << ' ' << msg << '\n';
+    log_out.write(line.str());
   };
 
+  inflight_registry inflight;
+  worker_config.inflight = &inflight;
+
   trip::router router;
   router
-      .get(std::regex("/find/task/([0-9a-f]{24})"), handle_find_task{test_task_coll})
-      .get(std::regex("/tasks/(all|current|archived)"), handle_task_list{test_task_coll})
+      .get(std::regex("/find/task/([0-9a-f]{24})"), handle_find_task{*tasks})
+      .get(std::regex("/tasks/(all|current|archived)"), handle_task_list{*tasks})
       .options(std::regex("/execute"), handle_execution_preflight{})
-      .post(std::regex("/execute"), handle_execution{test_task_coll});
+      .options(std::regex("/compile"), handle_execution_preflight{})
+      .post(std::regex("/compile"), handle_compile{*tasks, compile_cache_size})
+      .post(std::regex("/execute"), handle_execution{*tasks, journal.get(), &stats, graders.get(), email_limiter.get(), scheduler.get(), &inflight})
+      .get(std::regex("/tasks/([0-9a-f]{24})/stats"), handle_task_stats{stats})
+      .get(std::regex("/tasks/([0-9a-f]{24})/leaderboard"), handle_leaderboard{stats})
+      .get(std::regex("/metrics"), handle_metrics{graders.get()});
+  if (assets.size() > 0)
+  {
+    router.get(std::regex("/.*"), handle_static{assets});
+  }
+
+  // Introspection and abort only ever listen on the loopback interface,
+  // without rate limits, capture or tracing. They run on their own
+  // io_context and thread, so they still answer when every I/O thread of
+  // the public workers is stuck in a script or a grader call.
+  boost::asio::io_context admin_ioc;
+  std::optional<tcp::acceptor> admin_acceptor;
+  std::optional<http_worker> admin_worker;
+  trip::router admin_router;
+  http_worker_config admin_config = worker_config;
+  admin_config.limiter = nullptr;
+  admin_config.capture = nullptr;
+  admin_config.tracer = nullptr;
+
+  warm_up(router, worker_config);
 
+  // Draining stops accepting and lets the requests in progress finish,
+  // up to the drain timeout, before the server stops.
   std::list<http_worker> workers;
+  net::steady_timer drain_timer{ioc};
+  std::chrono::steady_clock::time_point drain_deadline;
+  std::atomic<bool> draining{false};
+  std::function<void()> wait_for_workers = [&]
+  {
+    drain_timer.expires_after(std::chrono::milliseconds(50));
+    drain_timer.async_wait(
+        [&](boost::system::error_code const &ec)
+        {
+          if (ec)
+          {
+            return;
+          }
+          bool const busy = std::any_of(workers.begin(), workers.end(), [](http_worker const &w) { return w.busy(); });
+          if (busy && std::chrono::steady_clock::now() < drain_deadline)
+          {
+            wait_for_workers();
+          }
+          else
+          {
+            ioc.stop();
+          }
+        });
+  };
+  std::unique_ptr<listener_handoff> handoff;
+  std::function<void()> drain = [&]
+  {
+    if (draining.exchange(true))
+    {
+      return;
+    }
+    drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(drain_timeout);
+    if (handoff)
+    {
+      handoff->stop();
+    }
+    boost::system::error_code ec;
+    // only our descriptor: after a handoff the successor keeps accepting
+    // on the same socket
+    acceptor.close(ec);
+    std::cout << "draining ..." << std::endl;
+    wait_for_workers();
+  };
+
+  // Bound before taking over the listener: a successor that cannot serve
+  // the admin port gives up while its predecessor still serves everything.
+  // Both share the port (SO_REUSEPORT) until the predecessor exits.
+  if (admin_port != 0)
+  {
+    try
+    {
+      tcp::endpoint const admin_endpoint{net::ip::address_v4::loopback(), admin_port};
+      admin_acceptor.emplace(admin_ioc);
+      admin_acceptor->open(admin_endpoint.protocol());
+      admin_acceptor->set_option(tcp::acceptor::reuse_address(true));
+      admin_acceptor->set_option(net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+      admin_acceptor->bind(admin_endpoint);
+      admin_acceptor->listen();
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << "Cannot listen on 127.0.0.1:" << admin_port << ": " << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  net::local::stream_protocol::socket predecessor{ioc};
+  try
+  {
+    tcp::endpoint const endpoint{host, port};
+    int predecessor_fd = -1;
+    int const listener = handoff_socket.empty() ? -1 : listener_handoff::take_over(handoff_socket, &predecessor_fd);
+    if (predecessor_fd >= 0)
+    {
+      predecessor.assign(net::local::stream_protocol(), predecessor_fd);
+    }
+    if (listener >= 0)
+    {
+      acceptor.assign(endpoint.protocol(), listener);
+      std::cout << "took over the listener from the server at " << handoff_socket << std::endl;
+    }
+    else
+    {
+      acceptor.open(endpoint.protocol());
+      acceptor.set_option(tcp::acceptor::reuse_address(true));
+      acceptor.bind(endpoint);
+      acceptor.listen();
+    }
+    if (!handoff_socket.empty())
+    {
+      handoff = std::make_unique<listener_handoff>(ioc, handoff_socket, acceptor.native_handle(), [&] { drain(); });
+    }
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "Cannot listen on " << host << ':' << port << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (predecessor.is_open())
+  {
+    predecessor.async_wait(
+        net::socket_base::wait_read,
+        [&](boost::system::error_code const &)
+        {
+          boost::system::error_code ec;
+          predecessor.close(ec);
+          load_stats();
+        });
+  }
+  else
+  {
+    load_stats();
+  }
+
   for (auto i = 0U; i < num_workers; ++i)
   {
-    workers.emplace_back(acceptor, router, &logger);
+    workers.emplace_back(acceptor, router, worker_config, &logger);
     workers.back().start();
   }
 
+  if (admin_acceptor)
+  {
+    admin_router
+        .get(std::regex("/admin/inflight"), handle_inflight{inflight})
+        .post(std::regex("/admin/inflight/([0-9]+)/abort"), handle_inflight_abort{inflight})
+        .get(std::regex("/metrics"), handle_metrics{graders.get()});
+    admin_worker.emplace(*admin_acceptor, admin_router, admin_config, &logger);
+    admin_worker->start();
+    std::cout << "admin interface on 127.0.0.1:" << admin_port << std::endl;
+  }
+
   std::vector<std::thread> threads;
   threads.reserve(num_threads - 1);
   for (auto i = 0U; i < num_threads - 1; ++i)
@@ -144,17 +704,45 @@ int main(int argc, const char *argv[])
           ioc.run();
         });
   }
+  std::thread admin_thread;
+  if (admin_worker)
+  {
+    admin_thread = std::thread(
+        [&admin_ioc]
+        {
+          admin_ioc.run();
+        });
+  }
+
+  if (handoff)
+  {
+    handoff->start();
+  }
 
+  // the first signal drains, the second one stops at once
   net::signal_set signals(ioc, SIGINT, SIGTERM);
   signals.async_wait(
-      [&ioc](boost::system::error_code const &, int)
+      [&](boost::system::error_code const &ec, int)
       {
-        ioc.stop();
+        if (ec)
+        {
+          return;
+        }
+        drain();
+        signals.async_wait(
+            [&ioc](boost::system::error_code const &ec, int)
+            {
+              if (!ec)
+              {
+                ioc.stop();
+              }
+            });
       });
 
   std::cout << (num_workers > 1 ? std::to_string(num_workers) + " workers" : " 1 worker")
             << (num_threads > 1 ? " in " + std::to_string(num_threads) + " threads" : " in 1 thread")
-            << " listening on " << host << ':' << port << " ..."
+            << " listening on " << host << ':' << port
+            << " (" << log_writer::backend() << ") ..."
             << std::endl;
 
   ioc.run();
@@ -163,6 +751,16 @@ int main(int argc, const char *argv[])
   {
     t.join();
   }
+  if (admin_thread.joinable())
+  {
+    admin_ioc.stop();
+    admin_thread.join();
+  }
+
+  if (stats_loaded)
+  {
+    save_stats();
+  }
 
   return EXIT_SUCCESS;
 }
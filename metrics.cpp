@@ -0,0 +1,82 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "metrics.hpp"
+
+namespace
+{
+    void write_counter(std::ostream &os, char const *name, char const *help, std::atomic<std::uint64_t> const &value)
+    {
+        os << "# HELP " << name << ' ' << help << '\n'
+           << "# TYPE " << name << " counter\n"
+           << name << ' ' << value.load(std::memory_order_relaxed) << '\n';
+    }
+
+    void write_gauge(std::ostream &os, char const *name, char const *help, double value)
+    {
+        os << "# HELP " << name << ' ' << help << '\n'
+           << "# TYPE " << name << " gauge\n"
+           << name << ' ' << value << '\n';
+    }
+}
+
+server_metrics &metrics()
+{
+    static server_metrics instance;
+    return instance;
+}
+
+std::string server_metrics::to_prometheus() const
+{
+    std::ostringstream os;
+    write_counter(os, "angel_header_timeouts_total", "Connections closed because the request header did not arrive in time.", header_timeouts);
+    write_counter(os, "angel_body_timeouts_total", "Connections closed because the request body did not arrive in time.", body_timeouts);
+    write_counter(os, "angel_write_timeouts_total", "Connections closed because the response could not be written in time.", write_timeouts);
+    write_counter(os, "angel_oversized_requests_total", "Requests rejected for exceeding the header or body size limit.", oversized_requests);
+    write_counter(os, "angel_compression_bytes_in_total", "Uncompressed bytes of compressed responses.", compression_bytes_in);
+    write_counter(os, "angel_compression_bytes_out_total", "Compressed bytes of compressed responses.", compression_bytes_out);
+    write_counter(os, "angel_compression_cache_hits_total", "Responses served from the compression cache.", compression_cache_hits);
+    write_counter(os, "angel_compression_cache_misses_total", "Responses that had to be compressed.", compression_cache_misses);
+    std::uint64_t const bytes_in = compression_bytes_in.load(std::memory_order_relaxed);
+    write_gauge(os, "angel_compression_ratio", "Compressed size divided by uncompressed size of all compressed responses.",
+                bytes_in > 0 ? static_cast<double>(compression_bytes_out.load(std::memory_order_relaxed)) / static_cast<double>(bytes_in) : 1.0);
+    write_counter(os, "angel_journal_written_db_total", "Submissions written to the database.", journal_written_db);
+    write_counter(os, "angel_journal_written_file_total", "Submissions written to the fallback file.", journal_written_file);
+    write_counter(os, "angel_journal_dropped_total", "Submissions that could not be journaled.", journal_dropped);
+    write_gauge(os, "angel_journal_queue_depth", "Submissions waiting to be journaled.", static_cast<double>(journal_queue_depth.load(std::memory_order_relaxed)));
+    write_counter(os, "angel_compile_cache_hits_total", "Compile checks answered from the cache.", compile_cache_hits);
+    write_counter(os, "angel_compile_cache_misses_total", "Compile checks that had to build the script.", compile_cache_misses);
+    write_counter(os, "angel_rate_limited_ip_total", "Requests rejected because their client address exceeded its rate limit.", rate_limited_ip);
+    write_counter(os, "angel_rate_limited_email_total", "Submissions rejected because their email exceeded its rate limit.", rate_limited_email);
+    write_counter(os, "angel_coalesced_task_fetches_total", "Task lookups answered by a concurrent identical database query.", coalesced_task_fetches);
+    write_counter(os, "angel_coalesced_builds_total", "Script builds answered by a concurrent build of the same script.", coalesced_builds);
+    write_counter(os, "angel_scheduler_slices_total", "Time slices scripts have run for.", scheduler_slices);
+    write_gauge(os, "angel_scheduler_queue_depth", "Scripts waiting for their next time slice.", static_cast<double>(scheduler_queue_depth.load(std::memory_order_relaxed)));
+    write_counter(os, "angel_cancelled_executions_total", "Script executions stopped because the client disconnected or an operator aborted them.", cancelled_executions);
+    write_gauge(os, "angel_task_index_size", "Task ids in the in-memory existence index.", static_cast<double>(task_index_size.load(std::memory_order_relaxed)));
+    write_counter(os, "angel_task_index_rejected_total", "Lookups of unknown task ids answered without a database query.", task_index_rejected);
+    write_counter(os, "angel_task_index_false_positives_total", "Unknown task ids the Bloom filter let through and the id list caught.", task_index_false_positives);
+    write_counter(os, "angel_task_cache_hits_total", "Task lookups a grader answered from its task cache.", task_cache_hits);
+    write_counter(os, "angel_task_cache_misses_total", "Task lookups a grader had to send to the task storage.", task_cache_misses);
+#ifndef NDEBUG
+    write_counter(os, "angel_debug_request_allocations_total", "Heap allocations made while reading, routing and writing requests.", request_allocations);
+    write_counter(os, "angel_debug_allocation_counted_requests_total", "Requests whose heap allocations were counted.", allocation_counted_requests);
+#endif
+    return os.str();
+}
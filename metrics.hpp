@@ -0,0 +1,62 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __METRICS_HPP__
+#define __METRICS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct server_metrics
+{
+    std::atomic<std::uint64_t> header_timeouts{0};
+    std::atomic<std::uint64_t> body_timeouts{0};
+    std::atomic<std::uint64_t> write_timeouts{0};
+    std::atomic<std::uint64_t> oversized_requests{0};
+    std::atomic<std::uint64_t> compression_bytes_in{0};
+    std::atomic<std::uint64_t> compression_bytes_out{0};
+    std::atomic<std::uint64_t> compression_cache_hits{0};
+    std::atomic<std::uint64_t> compression_cache_misses{0};
+    std::atomic<std::uint64_t> journal_written_db{0};
+    std::atomic<std::uint64_t> journal_written_file{0};
+    std::atomic<std::uint64_t> journal_dropped{0};
+    std::atomic<std::uint64_t> journal_queue_depth{0};
+    std::atomic<std::uint64_t> compile_cache_hits{0};
+    std::atomic<std::uint64_t> compile_cache_misses{0};
+    std::atomic<std::uint64_t> rate_limited_ip{0};
+    std::atomic<std::uint64_t> rate_limited_email{0};
+    std::atomic<std::uint64_t> coalesced_task_fetches{0};
+    std::atomic<std::uint64_t> coalesced_builds{0};
+    std::atomic<std::uint64_t> scheduler_slices{0};
+    std::atomic<std::uint64_t> scheduler_queue_depth{0};
+    std::atomic<std::uint64_t> cancelled_executions{0};
+    std::atomic<std::uint64_t> task_index_size{0};
+    std::atomic<std::uint64_t> task_index_rejected{0};
+    std::atomic<std::uint64_t> task_index_false_positives{0};
+    std::atomic<std::uint64_t> task_cache_hits{0};
+    std::atomic<std::uint64_t> task_cache_misses{0};
+    // only counted in debug builds
+    std::atomic<std::uint64_t> request_allocations{0};
+    std::atomic<std::uint64_t> allocation_counted_requests{0};
+
+    std::string to_prometheus() const;
+};
+
+extern server_metrics &metrics();
+
+#endif // __METRICS_HPP__
@@ -0,0 +1,182 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+#include <boost/beast/http/verb.hpp>
+
+#include "rate_limiter.hpp"
+#include "metrics.hpp"
+
+namespace chrono = std::chrono;
+namespace http = boost::beast::http;
+
+rate_limit parse_rate_limit(std::string const &spec)
+{
+    rate_limit limit{};
+    try
+    {
+        std::size_t pos = 0;
+        limit.rate = std::stod(spec, &pos);
+        if (pos < spec.size())
+        {
+            if (spec[pos] != ':')
+            {
+                throw std::invalid_argument(spec);
+            }
+            std::size_t end = 0;
+            limit.burst = std::stod(spec.substr(pos + 1), &end);
+            if (pos + 1 + end != spec.size())
+            {
+                throw std::invalid_argument(spec);
+            }
+        }
+        else
+        {
+            limit.burst = std::max(1.0, limit.rate);
+        }
+    }
+    catch (std::logic_error const &)
+    {
+        throw std::invalid_argument("malformed rate limit \"" + spec + "\", expected <rate>[:<burst>]");
+    }
+    if (!(limit.rate > 0.0) || !(limit.burst >= 1.0))
+    {
+        throw std::invalid_argument("rate limit \"" + spec + "\" needs a positive rate and a burst of at least 1");
+    }
+    return limit;
+}
+
+rate_limiter::rate_limiter(rate_limit limit)
+    : limit_(limit)
+    , refill_time_(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(limit.burst / limit.rate)))
+{
+}
+
+std::optional<chrono::seconds> rate_limiter::acquire(std::string_view key)
+{
+    return acquire(key, chrono::steady_clock::now());
+}
+
+std::optional<chrono::seconds> rate_limiter::acquire(std::string_view key, chrono::steady_clock::time_point now)
+{
+    shard &s = shards_[std::hash<std::string_view>{}(key) % SHARDS];
+    std::lock_guard<std::mutex> lock(s.mtx);
+    if (++s.ops % SWEEP_EVERY == 0)
+    {
+        sweep(s, now);
+    }
+    auto it = s.buckets.find(std::string(key));
+    if (it == s.buckets.end())
+    {
+        s.buckets.emplace(std::string(key), bucket{limit_.burst - 1.0, now});
+        return std::nullopt;
+    }
+    bucket &b = it->second;
+    double const elapsed = chrono::duration<double>(now - b.last).count();
+    b.tokens = std::min(limit_.burst, b.tokens + elapsed * limit_.rate);
+    b.last = now;
+    if (b.tokens >= 1.0)
+    {
+        b.tokens -= 1.0;
+        return std::nullopt;
+    }
+    return chrono::seconds(static_cast<chrono::seconds::rep>(std::ceil((1.0 - b.tokens) / limit_.rate)));
+}
+
+std::size_t rate_limiter::size() const
+{
+    std::size_t n = 0;
+    for (auto const &s : shards_)
+    {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        n += s.buckets.size();
+    }
+    return n;
+}
+
+void rate_limiter::sweep(shard &s, chrono::steady_clock::time_point now)
+{
+    for (auto it = s.buckets.begin(); it != s.buckets.end();)
+    {
+        if (now - it->second.last >= refill_time_)
+        {
+            it = s.buckets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void request_limiter::add_rule(std::string const &spec)
+{
+    auto const eq = spec.rfind('=');
+    if (eq == std::string::npos || eq == 0)
+    {
+        throw std::invalid_argument("malformed rate limit rule \"" + spec + "\", expected [<METHOD> ]<path regex>=<rate>[:<burst>]");
+    }
+    std::string route = spec.substr(0, eq);
+    rule r;
+    auto const space = route.find(' ');
+    if (space != std::string::npos)
+    {
+        http::verb const method = http::string_to_verb(route.substr(0, space));
+        if (method == http::verb::unknown)
+        {
+            throw std::invalid_argument("unknown method in rate limit rule \"" + spec + "\"");
+        }
+        r.method = method;
+        route = route.substr(space + 1);
+    }
+    try
+    {
+        r.path = std::regex(route);
+    }
+    catch (std::regex_error const &e)
+    {
+        throw std::invalid_argument("invalid path in rate limit rule \"" + spec + "\": " + e.what());
+    }
+    r.limiter = std::make_unique<rate_limiter>(parse_rate_limit(spec.substr(eq + 1)));
+    rules_.push_back(std::move(r));
+}
+
+std::optional<chrono::seconds> request_limiter::admit(http::verb method, std::string_view path, std::string_view client)
+{
+    for (auto &r : rules_)
+    {
+        if ((!r.method || *r.method == method) && std::regex_match(path.begin(), path.end(), r.path))
+        {
+            auto retry_after = r.limiter->acquire(client);
+            if (retry_after)
+            {
+                ++metrics().rate_limited_ip;
+            }
+            return retry_after;
+        }
+    }
+    return std::nullopt;
+}
+
+bool request_limiter::empty() const
+{
+    return rules_.empty();
+}
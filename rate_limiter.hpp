@@ -0,0 +1,108 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RATE_LIMITER_HPP__
+#define __RATE_LIMITER_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/beast/http/verb.hpp>
+
+struct rate_limit
+{
+    double rate;  // tokens per second
+    double burst; // bucket capacity
+};
+
+// Parses "<rate>[:<burst>]", e.g. "0.5:10". The burst defaults to the
+// rate, but at least one request. Throws std::invalid_argument.
+extern rate_limit parse_rate_limit(std::string const &spec);
+
+// Token buckets keyed by client address or email. The keys are spread
+// over mutex-striped shards. A bucket that has been idle long enough to
+// refill completely is equivalent to no bucket; such buckets are swept
+// lazily while their shard is in use.
+class rate_limiter
+{
+public:
+    explicit rate_limiter(rate_limit limit);
+    rate_limiter(rate_limiter const &) = delete;
+    rate_limiter &operator=(rate_limiter const &) = delete;
+
+    // Takes a token from the key's bucket. If there is none, returns how
+    // long the client has to wait for the next one.
+    std::optional<std::chrono::seconds> acquire(std::string_view key);
+    std::optional<std::chrono::seconds> acquire(std::string_view key, std::chrono::steady_clock::time_point now);
+    std::size_t size() const;
+
+private:
+    static constexpr std::size_t SHARDS = 64;
+    static constexpr std::uint32_t SWEEP_EVERY = 1024;
+
+    struct bucket
+    {
+        double tokens;
+        std::chrono::steady_clock::time_point last;
+    };
+
+    struct alignas(64) shard
+    {
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, bucket> buckets;
+        std::uint32_t ops = 0;
+    };
+
+    rate_limit limit_;
+    std::chrono::steady_clock::duration refill_time_;
+    std::array<shard, SHARDS> shards_;
+
+    void sweep(shard &s, std::chrono::steady_clock::time_point now);
+};
+
+// Per-route limits on client addresses, checked before a request is
+// routed. The first rule whose method and path match decides.
+class request_limiter
+{
+public:
+    // spec: "[<METHOD> ]<path regex>=<rate>[:<burst>]", e.g. "POST /execute=1:10".
+    // Throws std::invalid_argument if the spec is malformed.
+    void add_rule(std::string const &spec);
+    std::optional<std::chrono::seconds> admit(boost::beast::http::verb method, std::string_view path, std::string_view client);
+    bool empty() const;
+
+private:
+    struct rule
+    {
+        std::optional<boost::beast::http::verb> method;
+        std::regex path;
+        std::unique_ptr<rate_limiter> limiter;
+    };
+    std::vector<rule> rules_;
+};
+
+#endif // __RATE_LIMITER_HPP__
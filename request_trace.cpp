@@ -0,0 +1,170 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "request_trace.hpp"
+#include "helper.hpp"
+
+namespace chrono = std::chrono;
+
+namespace
+{
+    thread_local request_trace *current_trace = nullptr;
+
+    double msecs(chrono::steady_clock::duration d)
+    {
+        return chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+request_trace::request_trace(std::string target)
+    : target_(std::move(target))
+    , start_(chrono::steady_clock::now())
+{
+}
+
+void request_trace::add(std::string name, std::string description,
+                        chrono::steady_clock::time_point start,
+                        chrono::steady_clock::time_point end)
+{
+    spans_.push_back(trace_span{std::move(name), std::move(description), start, end});
+}
+
+std::string request_trace::server_timing() const
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+    for (auto const &span : spans_)
+    {
+        if (os.tellp() > 0)
+        {
+            os << ", ";
+        }
+        os << span.name;
+        if (!span.description.empty())
+        {
+            os << ";desc=\"" << span.description << '"';
+        }
+        os << ";dur=" << msecs(span.end - span.start);
+    }
+    return os.str();
+}
+
+std::string const &request_trace::target() const
+{
+    return target_;
+}
+
+chrono::steady_clock::time_point request_trace::start() const
+{
+    return start_;
+}
+
+std::vector<trace_span> const &request_trace::spans() const
+{
+    return spans_;
+}
+
+request_trace *request_trace::current()
+{
+    return current_trace;
+}
+
+trace_activation::trace_activation(request_trace *trace)
+    : previous_(current_trace)
+{
+    current_trace = trace;
+}
+
+trace_activation::~trace_activation()
+{
+    current_trace = previous_;
+}
+
+scoped_span::scoped_span(char const *name, std::string description)
+    : trace_(current_trace)
+    , name_(name)
+    , description_(std::move(description))
+{
+    if (trace_ != nullptr)
+    {
+        start_ = chrono::steady_clock::now();
+    }
+}
+
+scoped_span::~scoped_span()
+{
+    if (trace_ != nullptr)
+    {
+        trace_->add(name_, std::move(description_), start_, chrono::steady_clock::now());
+    }
+}
+
+trace_writer::trace_writer(std::string const &path, unsigned int sample_every)
+    : out_(path, std::ios::out | std::ios::trunc)
+    , sample_every_(std::max(1U, sample_every))
+    , epoch_(chrono::steady_clock::now())
+{
+    out_ << "[\n";
+}
+
+bool trace_writer::sample()
+{
+    return counter_.fetch_add(1, std::memory_order_relaxed) % sample_every_ == 0;
+}
+
+void trace_writer::write(request_trace const &trace, std::uint64_t thread_id)
+{
+    auto const usecs = [this](chrono::steady_clock::time_point t)
+    {
+        return chrono::duration_cast<chrono::microseconds>(t - epoch_).count();
+    };
+    std::ostringstream os;
+    auto const event = [&](std::string const &name, std::string const &description,
+                           chrono::steady_clock::time_point start,
+                           chrono::steady_clock::time_point end)
+    {
+        os << "{\"name\":\"" << json_escape(name)
+           << "\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":" << usecs(start)
+           << ",\"dur\":" << chrono::duration_cast<chrono::microseconds>(end - start).count()
+           << ",\"pid\":" << ::getpid()
+           << ",\"tid\":" << thread_id;
+        if (!description.empty())
+        {
+            os << ",\"args\":{\"desc\":\"" << json_escape(description) << "\"}";
+        }
+        os << "},\n";
+    };
+    auto end = trace.start();
+    for (auto const &span : trace.spans())
+    {
+        end = std::max(end, span.end);
+    }
+    event(trace.target(), "", trace.start(), end);
+    for (auto const &span : trace.spans())
+    {
+        event(span.name, span.description, span.start, span.end);
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    out_ << os.str();
+    out_.flush();
+}
@@ -0,0 +1,111 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REQUEST_TRACE_HPP__
+#define __REQUEST_TRACE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct trace_span
+{
+    std::string name;
+    std::string description;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+// Spans recorded while one request is served. The worker activates the
+// trace on its thread for the time the router runs, so handlers can add
+// spans with scoped_span without having the trace passed in.
+class request_trace
+{
+public:
+    explicit request_trace(std::string target);
+    void add(std::string name, std::string description,
+             std::chrono::steady_clock::time_point start,
+             std::chrono::steady_clock::time_point end);
+    // Value of the Server-Timing header, e.g. `read;dur=0.120, route;dur=3.400`.
+    std::string server_timing() const;
+    std::string const &target() const;
+    std::chrono::steady_clock::time_point start() const;
+    std::vector<trace_span> const &spans() const;
+
+    // Trace of the request being served on this thread, or nullptr.
+    static request_trace *current();
+
+private:
+    friend class trace_activation;
+    std::string target_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<trace_span> spans_;
+};
+
+class trace_activation
+{
+public:
+    explicit trace_activation(request_trace *trace);
+    ~trace_activation();
+    trace_activation(trace_activation const &) = delete;
+    trace_activation &operator=(trace_activation const &) = delete;
+
+private:
+    request_trace *previous_;
+};
+
+// Records the time until it goes out of scope as a span of the current
+// trace. Does nothing if no trace is active.
+class scoped_span
+{
+public:
+    explicit scoped_span(char const *name, std::string description = {});
+    ~scoped_span();
+    scoped_span(scoped_span const &) = delete;
+    scoped_span &operator=(scoped_span const &) = delete;
+
+private:
+    request_trace *trace_;
+    char const *name_;
+    std::string description_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Appends every n-th finished trace to a file in Chrome's trace event
+// format, which chrome://tracing and Perfetto open directly. The file is
+// a JSON array that is never closed; both viewers accept that.
+class trace_writer
+{
+public:
+    trace_writer(std::string const &path, unsigned int sample_every);
+    // Decides whether the request about to start is sampled.
+    bool sample();
+    void write(request_trace const &trace, std::uint64_t thread_id);
+
+private:
+    std::mutex mtx_;
+    std::ofstream out_;
+    unsigned int sample_every_;
+    std::atomic<std::uint64_t> counter_{0};
+    std::chrono::steady_clock::time_point epoch_;
+};
+
+#endif // __REQUEST_TRACE_HPP__
@@ -0,0 +1,53 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "script_engine.hpp"
+
+#include <scriptstdstring/scriptstdstring.h>
+#include <scriptmath/scriptmath.h>
+
+asIScriptEngine *create_script_engine()
+{
+    asIScriptEngine *engine = asCreateScriptEngine();
+    if (engine == nullptr)
+    {
+        return nullptr;
+    }
+    RegisterStdString(engine);
+    RegisterScriptMath_Native(engine);
+    return engine;
+}
+
+char const *severity_name(asEMsgType type)
+{
+    switch (type)
+    {
+    case asMSGTYPE_WARNING:
+        return "WARN";
+    case asMSGTYPE_INFORMATION:
+        return "INFO";
+    case asMSGTYPE_ERROR:
+        return "ERROR";
+    default:
+        return "LOG";
+    }
+}
+
+void DiagnosticCallback(const asSMessageInfo *msg, std::vector<compile_diagnostic> *out)
+{
+    out->push_back(compile_diagnostic{msg->section, msg->row, msg->col, severity_name(msg->type), msg->message});
+}
@@ -0,0 +1,44 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCRIPT_ENGINE_HPP__
+#define __SCRIPT_ENGINE_HPP__
+
+#include <string>
+#include <vector>
+
+#include <angelscript.h>
+
+struct compile_diagnostic
+{
+    std::string section;
+    int row;
+    int col;
+    std::string severity;
+    std::string message;
+};
+
+// Creates an engine with everything registered that scripts may use.
+// Returns nullptr on failure. The caller sets the message callback.
+extern asIScriptEngine *create_script_engine();
+
+extern char const *severity_name(asEMsgType type);
+
+// Message callback collecting compiler output for structured reporting.
+extern void DiagnosticCallback(const asSMessageInfo *msg, std::vector<compile_diagnostic> *out);
+
+#endif // __SCRIPT_ENGINE_HPP__
@@ -0,0 +1,482 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <angelscript.h>
+
+#include <bsoncxx/json.hpp>
+
+#include "script_execution.hpp"
+#include "script_engine.hpp"
+#include "cpu_time.hpp"
+#include "helper.hpp"
+#include "metrics.hpp"
+#include "request_trace.hpp"
+#include "singleflight.hpp"
+
+namespace chrono = std::chrono;
+
+// CPU time a script may use per test
+constexpr chrono::seconds TIME_BUDGET{5};
+// wall-clock time after which a test is aborted however little CPU it got
+constexpr chrono::seconds WALL_CEILING{30};
+
+void PrintString(std::string const &s)
+{
+    std::cout << s << std::endl;
+}
+
+void PrintString_Generic(asIScriptGeneric *gen)
+{
+    const std::string *const str = reinterpret_cast<std::string *>(gen->GetArgAddress(0));
+    std::cout << *str << std::endl;
+}
+
+struct line_state
+{
+    chrono::nanoseconds cpu_start;
+    chrono::nanoseconds cpu_budget;
+    // A thread cannot use more CPU than wall time, so the CPU clock (a
+    // system call) is only read once this much wall time has passed.
+    chrono::steady_clock::time_point cpu_check;
+    chrono::steady_clock::time_point wall_deadline;
+    script_profile *profile;
+    cancellation_token *cancel;
+    execution_slot *inflight;
+};
+
+void LineCallback(asIScriptContext *ctx, line_state *state)
+{
+    if (state->profile != nullptr)
+    {
+        state->profile->record_line(ctx);
+    }
+    if (state->inflight != nullptr && state->inflight->record_line(ctx->GetLineNumber()))
+    {
+        ctx->Abort();
+        return;
+    }
+    auto const now = chrono::steady_clock::now();
+    if (now >= state->wall_deadline || (state->cancel != nullptr && state->cancel->poll(now)))
+    {
+        ctx->Abort();
+    }
+    else if (now >= state->cpu_check)
+    {
+        chrono::nanoseconds const used = thread_cpu_time() - state->cpu_start;
+        if (used >= state->cpu_budget)
+        {
+            ctx->Abort();
+        }
+        else
+        {
+            state->cpu_check = now + (state->cpu_budget - used);
+        }
+    }
+}
+
+void MessageCallback(const asSMessageInfo *msg, std::stringstream *out)
+{
+    *out << "[" << severity_name(msg->type) << "] " << msg->section << " (" << msg->row << ", " << msg->col << ") " << msg->message << std::endl;
+}
+
+bool approximately_equal(float a, float b, float epsilon = 0.000001)
+{
+    return fabs(a - b) <= ((fabs(a) < fabs(b) ? fabs(b) : fabs(a)) * epsilon);
+}
+
+namespace
+{
+    // In-memory stream for saving and loading module bytecode.
+    class bytecode_stream : public asIBinaryStream
+    {
+    public:
+        explicit bytecode_stream(std::string &out)
+            : out_(&out)
+        {
+        }
+
+        explicit bytecode_stream(std::string_view in)
+            : in_(in)
+        {
+        }
+
+        int Write(const void *ptr, asUINT size) override
+        {
+            out_->append(static_cast<char const *>(ptr), size);
+            return 0;
+        }
+
+        int Read(void *ptr, asUINT size) override
+        {
+            if (in_.size() < size)
+            {
+                return -1;
+            }
+            std::memcpy(ptr, in_.data(), size);
+            in_.remove_prefix(size);
+            return 0;
+        }
+
+    private:
+        std::string *out_ = nullptr;
+        std::string_view in_;
+    };
+
+    struct build_result
+    {
+        std::string script;
+        bool ok = false;
+        std::string messages;
+        std::string bytecode;
+    };
+
+    // Identical scripts submitted at the same moment (e.g. a sample
+    // solution handed around) are compiled once; the other callers load
+    // the resulting bytecode into their own engines.
+    singleflight<std::string, std::shared_ptr<build_result const>> builds;
+
+    std::shared_ptr<build_result const> compile(asIScriptEngine *engine, asIScriptModule *mod, std::string_view script, bool save)
+    {
+        auto result = std::make_shared<build_result>();
+        result->script = script;
+        std::stringstream log;
+        engine->SetMessageCallback(asFUNCTION(MessageCallback), &log, asCALL_CDECL);
+        if (mod->AddScriptSection("script", script.data(), script.size()) < 0)
+        {
+            log << "AddScriptSection() failed." << std::endl;
+        }
+        else if (mod->Build() < 0)
+        {
+            log << "Build failed." << std::endl;
+        }
+        else
+        {
+            result->ok = true;
+            if (save)
+            {
+                bytecode_stream out(result->bytecode);
+                mod->SaveByteCode(&out);
+            }
+        }
+        result->messages = log.str();
+        return result;
+    }
+
+    bool build_module(asIScriptEngine *engine, asIScriptModule *mod, std::string_view script, std::stringstream &err_log)
+    {
+        bool shared = false;
+        auto build = builds.run(
+            to_hex(fnv1a_hash(script)),
+            [&]
+            {
+                return compile(engine, mod, script, true);
+            },
+            &shared);
+        if (shared)
+        {
+            ++metrics().coalesced_builds;
+            bytecode_stream in(std::string_view(build->bytecode));
+            if (build->script != script || (build->ok && mod->LoadByteCode(&in) < 0))
+            {
+                // hash collision or unloadable bytecode: build it ourselves
+                mod = engine->GetModule(0, asGM_ALWAYS_CREATE);
+                build = compile(engine, mod, script, false);
+            }
+        }
+        engine->SetMessageCallback(asFUNCTION(MessageCallback), &err_log, asCALL_CDECL);
+        err_log << build->messages;
+        return build->ok;
+    }
+}
+
+execution_result execute_script(std::string_view script, storage::task_repository &tasks, test_order_registry &test_order, bsoncxx::oid const &oid, execution_options const &options, std::string &err_msg, std::stringstream &err_log)
+{
+    inflight_execution inflight(options.inflight, oid.bytes(), fnv1a_hash(script));
+    storage::task_ptr result;
+    {
+        scoped_span span("db");
+        result = tasks.find(oid);
+    }
+    if (!result)
+    {
+        err_log << "OID »" << oid.to_string() << "« not found in database." << std::endl;
+        return execution_result{};
+    }
+#ifndef NDEBUG
+    err_log << "[DEBUG]" << bsoncxx::to_json(*result) << std::endl;
+#endif
+
+    if (!result->view()["tests"])
+    {
+        err_log << "Field \"tests\" not found in database." << std::endl;
+        return execution_result{true, false};
+    }
+    if (result->view()["tests"].type() != bsoncxx::type::k_array)
+    {
+        err_log << "Field \"tests\" is not an array." << std::endl;
+        return execution_result{true, false};
+    }
+    std::vector<bsoncxx::array::element> tests;
+    for (auto const &test : result->view()["tests"].get_array().value)
+    {
+        tests.push_back(test);
+    }
+
+    if (!result->view()["signature"])
+    {
+        err_log << "Field \"signature\" missing in task." << std::endl;
+        return execution_result{true, false};
+    }
+    if (result->view()["signature"].type() != bsoncxx::type::k_string)
+    {
+        err_log << "Field \"signature\" is not a string." << std::endl;
+        return execution_result{true, false};
+    }
+    auto signature = result->view()["signature"].get_string().value;
+
+    int rc;
+    std::optional<scoped_span> compile_span(std::in_place, "compile");
+    asIScriptEngine *engine = create_script_engine();
+    if (engine == nullptr)
+    {
+        std::cerr << "Failed to create script engine." << std::endl;
+        return execution_result{true, false};
+    }
+    rc = engine->SetMessageCallback(asFUNCTION(MessageCallback), &err_log, asCALL_CDECL);
+
+    asIScriptModule *mod = engine->GetModule(0, asGM_ALWAYS_CREATE);
+    if (!build_module(engine, mod, script, err_log))
+    {
+        engine->Release();
+        return execution_result{true, false};
+    }
+    asIScriptContext *ctx = engine->CreateContext();
+    if (ctx == nullptr)
+    {
+        err_log << "Failed to create the context." << std::endl;
+        engine->Release();
+        return execution_result{true, false};
+    }
+    asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl(signature.to_string().c_str());
+    if (func == nullptr)
+    {
+        err_log << "The function `" << signature.to_string() << "` could not be found." << std::endl;
+        ctx->Release();
+        engine->ShutDownAndRelease();
+        return execution_result{true, false};
+    }
+    compile_span.reset();
+    std::string const task_id = oid.to_string();
+    bool correct = true;
+    // the client hung up or an operator aborted the run
+    auto const unwanted = [&options, &inflight]
+    {
+        return (options.cancel != nullptr && options.cancel->poll(chrono::steady_clock::now())) ||
+               (inflight.slot() != nullptr && inflight.slot()->abort_requested());
+    };
+    bool cancelled = false;
+    std::vector<test_timing> timings;
+    for (std::size_t test_index : test_order.order(task_id, tests.size()))
+    {
+        if (unwanted())
+        {
+            cancelled = true;
+            break;
+        }
+        scoped_span test_span("test", std::to_string(test_index));
+        auto const &test = tests[test_index];
+        rc = ctx->Prepare(func);
+        if (rc < 0)
+        {
+            err_log << "Failed to prepare the context." << std::endl;
+            ctx->Release();
+            engine->ShutDownAndRelease();
+            return execution_result{true, false};
+        }
+        if (!test["input"])
+        {
+            err_log << "Field \"input\" missing in task." << std::endl;
+            ctx->Release();
+            engine->ShutDownAndRelease();
+            return execution_result{true, false};
+        }
+        if (test["input"].type() != bsoncxx::type::k_array)
+        {
+            err_log << "Field \"input\" is not an array." << std::endl;
+            ctx->Release();
+            engine->ShutDownAndRelease();
+            return execution_result{true, false};
+        }
+        auto input = test["input"].get_array().value;
+        if (!test["output"])
+        {
+            err_log << "Field \"output\" missing in task." << std::endl;
+            ctx->Release();
+            engine->ShutDownAndRelease();
+            return execution_result{true, false};
+        }
+        if (test["output"].type() != bsoncxx::type::k_double)
+        {
+            err_log << "Field \"output\" is not a double." << std::endl;
+            ctx->Release();
+            engine->ShutDownAndRelease();
+            return execution_result{true, false};
+        }
+        auto output = test["output"].get_double().value;
+        asUINT arg_idx = 0U;
+        for (auto i = input.cbegin(); i != input.cend(); ++i)
+        {
+            if (i->type() != bsoncxx::type::k_double)
+            {
+                err_log << "Field \"output\" does not contain double values." << std::endl;
+                ctx->Release();
+                engine->ShutDownAndRelease();
+                return execution_result{true, false};
+            }
+            ctx->SetArgFloat(arg_idx++, static_cast<float>(i->get_double().value));
+        }
+        auto const wall_start = chrono::steady_clock::now();
+        chrono::nanoseconds const wall_ceiling = std::min<chrono::nanoseconds>(WALL_CEILING, options.deadline - wall_start);
+        if (wall_ceiling <= chrono::nanoseconds(0))
+        {
+            err_log << "The script was aborted because the tests did not finish in time." << std::endl;
+            correct = false;
+            break;
+        }
+        chrono::nanoseconds cpu{0};
+        if (options.scheduler != nullptr)
+        {
+            script_run run;
+            run.ctx = ctx;
+            run.cpu_budget = TIME_BUDGET;
+            run.wall_ceiling = wall_ceiling;
+            run.profile = options.profile;
+            run.cancel = options.cancel;
+            run.inflight = inflight.slot();
+            rc = options.scheduler->run(run);
+            cpu = run.cpu_used;
+        }
+        else
+        {
+            line_state state{
+                thread_cpu_time(),
+                TIME_BUDGET,
+                wall_start + TIME_BUDGET,
+                wall_start + wall_ceiling,
+                options.profile,
+                options.cancel,
+                inflight.slot()};
+            rc = ctx->SetLineCallback(asFUNCTION(LineCallback), &state, asCALL_CDECL);
+            if (rc < 0)
+            {
+                err_log << "Failed to set the line callback function." << std::endl;
+                ctx->Release();
+                engine->ShutDownAndRelease();
+                return execution_result{true, false};
+            }
+            rc = ctx->Execute();
+            cpu = thread_cpu_time() - state.cpu_start;
+        }
+        timings.push_back(test_timing{test_index, cpu, chrono::steady_clock::now() - wall_start});
+        if (options.profile != nullptr)
+        {
+            options.profile->finish_run();
+        }
+        if (rc == asEXECUTION_FINISHED)
+        {
+            auto return_value = ctx->GetReturnFloat();
+            if (!approximately_equal(output, return_value))
+            {
+                test_order.record_failure(task_id, tests.size(), test_index);
+                correct = false;
+                break;
+            }
+        }
+        else if (rc == asEXECUTION_ABORTED && unwanted())
+        {
+            cancelled = true;
+            break;
+        }
+        else if (rc == asEXECUTION_ABORTED)
+        {
+            if (cpu >= TIME_BUDGET)
+            {
+                err_log << "The script was aborted after using up its CPU time of " << TIME_BUDGET.count() << " s." << std::endl;
+            }
+            else if (wall_ceiling < WALL_CEILING)
+            {
+                err_log << "The script was aborted because the tests did not finish in time." << std::endl;
+            }
+            else
+            {
+                err_log << "The script was aborted because it did not finish within " << WALL_CEILING.count() << " s." << std::endl;
+            }
+            correct = false;
+            break;
+        }
+        else if (rc == asEXECUTION_EXCEPTION)
+        {
+            err_log << "The script ended with an exception." << std::endl;
+            test_order.record_failure(task_id, tests.size(), test_index);
+            asIScriptFunction *func = ctx->GetExceptionFunction();
+            err_log << "func: " << func->GetDeclaration() << std::endl;
+            err_log << "modl: " << func->GetModuleName() << std::endl;
+            err_log << "sect: " << func->GetScriptSectionName() << std::endl;
+            err_log << "line: " << ctx->GetExceptionLineNumber() << std::endl;
+            err_log << "desc: " << ctx->GetExceptionString() << std::endl;
+            correct = false;
+            break;
+        }
+        else
+        {
+            err_log << "The script ended for some unforeseen reason (result code = " << rc << ")." << std::endl;
+            correct = false;
+            break;
+        }
+    }
+
+    ctx->Release();
+    engine->ShutDownAndRelease();
+
+    if (cancelled)
+    {
+        ++metrics().cancelled_executions;
+        return execution_result{true, false, true};
+    }
+    if (!correct)
+    {
+        err_msg = "Your script failed in at least one test. Try again.";
+    }
+    execution_result verdict{true, correct};
+    for (auto const &t : timings)
+    {
+        verdict.cpu += t.cpu;
+    }
+    verdict.tests = std::move(timings);
+    return verdict;
+}
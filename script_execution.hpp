@@ -0,0 +1,65 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCRIPT_EXECUTION_HPP__
+#define __SCRIPT_EXECUTION_HPP__
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bsoncxx/oid.hpp>
+
+#include "cancellation.hpp"
+#include "cpu_time.hpp"
+#include "inflight.hpp"
+#include "script_profiler.hpp"
+#include "script_scheduler.hpp"
+#include "test_order.hpp"
+#include "storage/task_repository.hpp"
+
+struct execution_result
+{
+    bool task_found = false;
+    bool correct = false;
+    // the client went away before all tests ran
+    bool cancelled = false;
+    // thread CPU time of all tests that ran, and of each of them
+    std::chrono::nanoseconds cpu{0};
+    std::vector<test_timing> tests{};
+};
+
+struct execution_options
+{
+    script_profile *profile = nullptr;
+    // runs the tests in time slices if set, else on the calling thread
+    script_scheduler *scheduler = nullptr;
+    // stops the run between lines and tests once cancelled
+    cancellation_token *cancel = nullptr;
+    // publishes the run for /admin/inflight, which can also abort it
+    inflight_registry *inflight = nullptr;
+    // all tests together must end by then; shortens the per-test ceiling
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Builds the script and runs it against all tests of the task. Compiler
+// and runtime messages go to err_log, the verdict for the user to err_msg.
+extern execution_result execute_script(std::string_view script, storage::task_repository &tasks, test_order_registry &test_order, bsoncxx::oid const &oid, execution_options const &options, std::string &err_msg, std::stringstream &err_log);
+
+#endif // __SCRIPT_EXECUTION_HPP__
@@ -0,0 +1,70 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "script_profiler.hpp"
+#include "helper.hpp"
+
+void script_profile::record_line(asIScriptContext *ctx)
+{
+    auto const now = std::chrono::steady_clock::now();
+    ++statements;
+    ++line_hits[ctx->GetLineNumber()];
+    if (current_function != nullptr)
+    {
+        run_time[current_function] += now - last_tick;
+    }
+    current_function = ctx->GetFunction();
+    last_tick = now;
+}
+
+void script_profile::finish_run()
+{
+    if (current_function != nullptr)
+    {
+        run_time[current_function] += std::chrono::steady_clock::now() - last_tick;
+        current_function = nullptr;
+    }
+    for (auto const &[func, time] : run_time)
+    {
+        function_time[func->GetDeclaration()] += time;
+    }
+    run_time.clear();
+}
+
+std::string script_profile::to_json() const
+{
+    std::ostringstream os;
+    os << "{\"statements\":" << statements << ",\"lines\":{";
+    bool first = true;
+    for (auto const &[line, hits] : line_hits)
+    {
+        os << (first ? "" : ",") << '"' << line << "\":" << hits;
+        first = false;
+    }
+    os << "},\"functions\":{";
+    first = true;
+    for (auto const &[decl, time] : function_time)
+    {
+        os << (first ? "" : ",") << '"' << json_escape(decl) << "\":"
+           << std::chrono::duration<double, std::milli>(time).count();
+        first = false;
+    }
+    os << "}}";
+    return os.str();
+}
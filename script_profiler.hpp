@@ -0,0 +1,55 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCRIPT_PROFILER_HPP__
+#define __SCRIPT_PROFILER_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <angelscript.h>
+
+// Per-line hit counts and per-function times of one submission, collected
+// from the line callback. AngelScript has no bytecode instruction
+// counter, so the number of executed statements (line callbacks) stands
+// in for the instruction count.
+struct script_profile
+{
+    std::uint64_t statements = 0;
+    std::map<int, std::uint64_t> line_hits;
+    // keyed by declaration, because the functions die with the engine
+    std::map<std::string, std::chrono::nanoseconds> function_time;
+
+    // time spent per function during the current run and the function
+    // and time of the previous line callback
+    std::unordered_map<asIScriptFunction *, std::chrono::nanoseconds> run_time;
+    asIScriptFunction *current_function = nullptr;
+    std::chrono::steady_clock::time_point last_tick{};
+
+    // Counts the current line of ctx and attributes the time since the
+    // previous line to the function it was in.
+    void record_line(asIScriptContext *ctx);
+    // Folds the current run into function_time; call after each Execute()
+    // while the engine is still alive.
+    void finish_run();
+    std::string to_json() const;
+};
+
+#endif // __SCRIPT_PROFILER_HPP__
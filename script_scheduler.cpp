@@ -0,0 +1,165 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "script_scheduler.hpp"
+#include "cpu_time.hpp"
+#include "metrics.hpp"
+
+namespace chrono = std::chrono;
+
+script_scheduler::script_scheduler(unsigned int threads, chrono::microseconds slice)
+    : slice_(std::max(slice, chrono::microseconds(100)))
+{
+    asPrepareMultithread();
+    for (unsigned int i = 0; i < std::max(1U, threads); ++i)
+    {
+        threads_.emplace_back(&script_scheduler::work, this);
+    }
+}
+
+script_scheduler::~script_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    for (auto &t : threads_)
+    {
+        t.join();
+    }
+}
+
+int script_scheduler::run(script_run &r)
+{
+    job j{};
+    j.run = &r;
+    j.deadline = chrono::steady_clock::now() + r.wall_ceiling;
+    r.cpu_used = chrono::nanoseconds(0);
+    if (r.ctx->SetLineCallback(asFUNCTION(line_callback), &j, asCALL_CDECL) < 0)
+    {
+        return asERROR;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    queue_.push_back(&j);
+    metrics().scheduler_queue_depth = queue_.size();
+    queue_cv_.notify_one();
+    done_cv_.wait(lock, [&j] { return j.done; });
+    return j.result;
+}
+
+void script_scheduler::line_callback(asIScriptContext *ctx, job *j)
+{
+    script_run &r = *j->run;
+    if (r.profile != nullptr)
+    {
+        r.profile->record_line(ctx);
+    }
+    if (r.inflight != nullptr && r.inflight->record_line(ctx->GetLineNumber()))
+    {
+        ctx->Abort();
+        return;
+    }
+    auto const now = chrono::steady_clock::now();
+    if (r.cancel != nullptr && r.cancel->poll(now))
+    {
+        ctx->Abort();
+    }
+    else if (now >= j->slice_end)
+    {
+        ctx->Suspend();
+    }
+}
+
+void script_scheduler::work()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true)
+    {
+        queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_)
+        {
+            break;
+        }
+        job *j = queue_.front();
+        queue_.pop_front();
+        metrics().scheduler_queue_depth = queue_.size();
+        lock.unlock();
+
+        script_run &r = *j->run;
+        auto const start = chrono::steady_clock::now();
+        if ((r.cancel != nullptr && r.cancel->poll(start)) ||
+            (r.inflight != nullptr && r.inflight->abort_requested()) ||
+            start >= j->deadline)
+        {
+            // cancelled, aborted or out of time while queued: drop the job
+            // instead of giving it another slice
+            r.ctx->Abort();
+            lock.lock();
+            j->result = asEXECUTION_ABORTED;
+            j->done = true;
+            done_cv_.notify_all();
+            continue;
+        }
+        if (r.inflight != nullptr)
+        {
+            r.inflight->thread.store(thread_index(), std::memory_order_relaxed);
+        }
+        // a thread cannot use more CPU than wall time, so the slice never
+        // outlasts the remaining budget
+        j->slice_end = start + std::min<chrono::nanoseconds>({slice_, r.cpu_budget - r.cpu_used, j->deadline - start});
+        if (r.profile != nullptr)
+        {
+            // time spent in the queue is nobody's
+            r.profile->last_tick = start;
+        }
+        auto const cpu_start = thread_cpu_time();
+        int rc = r.ctx->Execute();
+        r.cpu_used += thread_cpu_time() - cpu_start;
+        ++metrics().scheduler_slices;
+        bool requeue = false;
+        if (rc == asEXECUTION_SUSPENDED)
+        {
+            if (r.cpu_used >= r.cpu_budget || chrono::steady_clock::now() >= j->deadline)
+            {
+                r.ctx->Abort();
+                rc = asEXECUTION_ABORTED;
+            }
+            else
+            {
+                requeue = true;
+            }
+        }
+
+        lock.lock();
+        if (requeue)
+        {
+            queue_.push_back(j);
+            metrics().scheduler_queue_depth = queue_.size();
+        }
+        else
+        {
+            j->result = rc;
+            j->done = true;
+            done_cv_.notify_all();
+        }
+    }
+    lock.unlock();
+    asThreadCleanup();
+}
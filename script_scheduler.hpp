@@ -0,0 +1,92 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCRIPT_SCHEDULER_HPP__
+#define __SCRIPT_SCHEDULER_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <angelscript.h>
+
+#include "cancellation.hpp"
+#include "inflight.hpp"
+#include "script_profiler.hpp"
+
+// One prepared context to run to completion.
+struct script_run
+{
+    asIScriptContext *ctx = nullptr;
+    // thread CPU time the script may use
+    std::chrono::nanoseconds cpu_budget{};
+    // wall-clock time from submission after which it is aborted anyway,
+    // queueing included, so an overloaded server still answers
+    std::chrono::nanoseconds wall_ceiling{};
+    script_profile *profile = nullptr;
+    cancellation_token *cancel = nullptr;
+    execution_slot *inflight = nullptr;
+    // filled in by the scheduler
+    std::chrono::nanoseconds cpu_used{0};
+};
+
+// Shares a few threads among all running scripts. A context runs for one
+// time slice, is suspended from its line callback and goes to the back of
+// the queue, so a script spinning until its timeout cannot hold a thread
+// while short submissions wait. The budget counts only the CPU time a
+// script actually used, not the time it spent queued.
+class script_scheduler
+{
+public:
+    script_scheduler(unsigned int threads, std::chrono::microseconds slice);
+    ~script_scheduler();
+    script_scheduler(script_scheduler const &) = delete;
+    script_scheduler &operator=(script_scheduler const &) = delete;
+
+    // Runs r.ctx to completion and blocks until it is done. Returns the
+    // result of the last Execute(), or asEXECUTION_ABORTED if the budget or
+    // the ceiling ran out, cancel fired or the run was aborted through its
+    // inflight slot. Installs its own line callback; profile, cancel and
+    // inflight may be nullptr.
+    int run(script_run &r);
+
+private:
+    struct job
+    {
+        script_run *run;
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point slice_end;
+        int result = asEXECUTION_UNINITIALIZED;
+        bool done = false;
+    };
+
+    std::chrono::microseconds slice_;
+    std::mutex mtx_;
+    std::condition_variable queue_cv_;
+    std::condition_variable done_cv_;
+    std::deque<job *> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    void work();
+    static void line_callback(asIScriptContext *ctx, job *j);
+};
+
+#endif // __SCRIPT_SCHEDULER_HPP__
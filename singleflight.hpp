@@ -0,0 +1,87 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SINGLEFLIGHT_HPP__
+#define __SINGLEFLIGHT_HPP__
+
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Coalesces concurrent calls for the same key: the first caller runs the
+// function, callers arriving while it runs wait for and share its result
+// (or exception). Nothing is cached once the call has finished.
+template <typename Key, typename Value>
+class singleflight
+{
+public:
+    singleflight() = default;
+    singleflight(singleflight const &) = delete;
+    singleflight &operator=(singleflight const &) = delete;
+
+    // `shared` is set to true if the result came from another caller.
+    template <typename Fn>
+    Value run(Key const &key, Fn &&fn, bool *shared = nullptr)
+    {
+        std::promise<Value> promise;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto it = calls_.find(key);
+            if (it != calls_.end())
+            {
+                std::shared_future<Value> pending = it->second;
+                lock.unlock();
+                if (shared != nullptr)
+                {
+                    *shared = true;
+                }
+                return pending.get();
+            }
+            calls_.emplace(key, promise.get_future().share());
+        }
+        if (shared != nullptr)
+        {
+            *shared = false;
+        }
+        try
+        {
+            Value value = std::forward<Fn>(fn)();
+            promise.set_value(value);
+            forget(key);
+            return value;
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            forget(key);
+            throw;
+        }
+    }
+
+private:
+    std::unordered_map<Key, std::shared_future<Value>> calls_;
+    std::mutex mtx_;
+
+    void forget(Key const &key)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        calls_.erase(key);
+    }
+};
+
+#endif // __SINGLEFLIGHT_HPP__
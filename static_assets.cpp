@@ -0,0 +1,106 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "static_assets.hpp"
+#include "helper.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::string mime_type_of(fs::path const &path)
+    {
+        static std::unordered_map<std::string, std::string> const types = {
+            {".html", "text/html; charset=utf-8"},
+            {".htm", "text/html; charset=utf-8"},
+            {".css", "text/css; charset=utf-8"},
+            {".js", "text/javascript; charset=utf-8"},
+            {".json", "application/json"},
+            {".txt", "text/plain; charset=utf-8"},
+            {".svg", "image/svg+xml"},
+            {".png", "image/png"},
+            {".jpg", "image/jpeg"},
+            {".ico", "image/x-icon"},
+        };
+        auto it = types.find(path.extension().string());
+        return it != types.end() ? it->second : "application/octet-stream";
+    }
+
+    bool is_compressible(std::string const &mime_type)
+    {
+        return mime_type.compare(0, 5, "text/") == 0 ||
+               mime_type == "application/json" ||
+               mime_type == "image/svg+xml";
+    }
+}
+
+void static_assets::load(std::string const &directory)
+{
+    fs::path const root = fs::canonical(directory);
+    for (auto const &entry : fs::recursive_directory_iterator(root))
+    {
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+        std::ifstream in(entry.path(), std::ios::binary);
+        asset a;
+        a.mime_type = mime_type_of(entry.path());
+        a.identity.body.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        std::string const hash = to_hex(fnv1a_hash(a.identity.body));
+        a.identity.etag = '"' + hash + '"';
+        if (is_compressible(a.mime_type))
+        {
+            for (content_encoding encoding : {content_encoding::gzip, content_encoding::br})
+            {
+#ifndef WITH_BROTLI
+                if (encoding == content_encoding::br)
+                {
+                    continue;
+                }
+#endif
+                variant v{compress(a.identity.body, encoding), '"' + hash + '-' + to_string(encoding) + '"'};
+                if (v.body.size() < a.identity.body.size())
+                {
+                    a.encoded.emplace(encoding, std::move(v));
+                }
+            }
+        }
+        std::string const path = '/' + fs::relative(entry.path(), root).generic_string();
+        if (entry.path().filename() == "index.html")
+        {
+            std::string const dir = path.substr(0, path.size() - std::string("index.html").size());
+            assets_.emplace(dir, a);
+        }
+        assets_.emplace(path, std::move(a));
+    }
+}
+
+static_assets::asset const *static_assets::find(std::string const &path) const
+{
+    auto it = assets_.find(path);
+    return it != assets_.end() ? &it->second : nullptr;
+}
+
+std::size_t static_assets::size() const
+{
+    return assets_.size();
+}
@@ -0,0 +1,58 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATIC_ASSETS_HPP__
+#define __STATIC_ASSETS_HPP__
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "compression.hpp"
+
+// All files below a directory (usually html/), read once at startup
+// together with their ETags and precompressed variants.
+class static_assets
+{
+public:
+    struct variant
+    {
+        std::string body;
+        std::string etag;
+    };
+
+    struct asset
+    {
+        std::string mime_type;
+        variant identity;
+        std::map<content_encoding, variant> encoded;
+    };
+
+    static_assets() = default;
+    static_assets(static_assets const &) = delete;
+    static_assets &operator=(static_assets const &) = delete;
+
+    // Throws std::filesystem::filesystem_error if the directory cannot be read.
+    void load(std::string const &directory);
+    asset const *find(std::string const &path) const;
+    std::size_t size() const;
+
+private:
+    std::unordered_map<std::string, asset> assets_;
+};
+
+#endif // __STATIC_ASSETS_HPP__
@@ -0,0 +1,58 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "caching_task_repository.hpp"
+#include "../metrics.hpp"
+
+namespace storage
+{
+    caching_task_repository::caching_task_repository(std::unique_ptr<task_repository> backend, std::size_t capacity, std::chrono::seconds max_age)
+        : backend_(std::move(backend))
+        , max_age_(max_age)
+        , cache_(capacity)
+    {
+    }
+
+    task_ptr caching_task_repository::find(bsoncxx::oid const &id)
+    {
+        std::string key(id.bytes(), bsoncxx::oid::k_oid_length);
+        auto const now = std::chrono::steady_clock::now();
+        auto const cached = cache_.get(key);
+        if (cached && now - cached->fetched < max_age_)
+        {
+            ++metrics().task_cache_hits;
+            return cached->task;
+        }
+        ++metrics().task_cache_misses;
+        task_ptr task = backend_->find(id);
+        if (task)
+        {
+            cache_.put(key, entry{task, now});
+        }
+        return task;
+    }
+
+    std::vector<task_ptr> caching_task_repository::list(task_filter filter)
+    {
+        return backend_->list(filter);
+    }
+
+    bool caching_task_repository::may_contain(bsoncxx::oid const &id)
+    {
+        return backend_->may_contain(id);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_CACHING_TASK_REPOSITORY_HPP__
+#define __STORAGE_CACHING_TASK_REPOSITORY_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "task_repository.hpp"
+#include "../lru_cache.hpp"
+
+namespace storage
+{
+    // Keeps recently found tasks for a while. Graders use it: the front
+    // nodes send each task to the same grader, so its tasks stay cached
+    // there instead of being read from the backend for every submission.
+    // Edits of a task show up after at most max_age; unknown ids are not
+    // cached, so new tasks are found at once.
+    class caching_task_repository : public task_repository
+    {
+    public:
+        caching_task_repository(std::unique_ptr<task_repository> backend, std::size_t capacity, std::chrono::seconds max_age);
+
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+        bool may_contain(bsoncxx::oid const &id) override;
+
+    private:
+        struct entry
+        {
+            task_ptr task;
+            std::chrono::steady_clock::time_point fetched;
+        };
+
+        std::unique_ptr<task_repository> backend_;
+        std::chrono::seconds const max_age_;
+        lru_cache<std::string, entry> cache_;
+    };
+}
+
+#endif // __STORAGE_CACHING_TASK_REPOSITORY_HPP__
@@ -0,0 +1,61 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "coalescing_task_repository.hpp"
+#include "../metrics.hpp"
+
+namespace storage
+{
+    coalescing_task_repository::coalescing_task_repository(std::unique_ptr<task_repository> backend)
+        : backend_(std::move(backend))
+    {
+    }
+
+    task_ptr coalescing_task_repository::find(bsoncxx::oid const &id)
+    {
+        bool shared = false;
+        task_ptr task = finds_.run(
+            std::string(id.bytes(), bsoncxx::oid::k_oid_length),
+            [this, &id]
+            {
+                return backend_->find(id);
+            },
+            &shared);
+        if (shared)
+        {
+            ++metrics().coalesced_task_fetches;
+        }
+        return task;
+    }
+
+    std::vector<task_ptr> coalescing_task_repository::list(task_filter filter)
+    {
+        bool shared = false;
+        std::vector<task_ptr> tasks = lists_.run(
+            static_cast<int>(filter),
+            [this, filter]
+            {
+                return backend_->list(filter);
+            },
+            &shared);
+        if (shared)
+        {
+            ++metrics().coalesced_task_fetches;
+        }
+        return tasks;
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_COALESCING_TASK_REPOSITORY_HPP__
+#define __STORAGE_COALESCING_TASK_REPOSITORY_HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "task_repository.hpp"
+#include "../singleflight.hpp"
+
+namespace storage
+{
+    // Wraps a slow backend so that concurrent lookups of the same task, or
+    // listings with the same filter, turn into a single backend query.
+    class coalescing_task_repository : public task_repository
+    {
+    public:
+        explicit coalescing_task_repository(std::unique_ptr<task_repository> backend);
+
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+
+    private:
+        std::unique_ptr<task_repository> backend_;
+        singleflight<std::string, task_ptr> finds_;
+        singleflight<int, std::vector<task_ptr>> lists_;
+    };
+}
+
+#endif // __STORAGE_COALESCING_TASK_REPOSITORY_HPP__
@@ -0,0 +1,134 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "indexed_task_repository.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#include "../metrics.hpp"
+
+namespace chrono = std::chrono;
+
+namespace storage
+{
+    namespace
+    {
+        // how far ObjectId timestamps and our clock may disagree
+        constexpr chrono::seconds CLOCK_SLACK{60};
+    }
+
+    indexed_task_repository::indexed_task_repository(std::unique_ptr<task_repository> backend, chrono::seconds refresh_interval)
+        : backend_(std::move(backend))
+        , refresh_interval_(std::max(refresh_interval, chrono::seconds(1)))
+    {
+        refresh();
+        refresher_ = std::thread([this]
+                                 {
+            std::unique_lock<std::mutex> lock(mtx_);
+            while (!cv_.wait_for(lock, refresh_interval_, [this] { return stop_; }))
+            {
+                lock.unlock();
+                refresh();
+                lock.lock();
+            } });
+    }
+
+    indexed_task_repository::~indexed_task_repository()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        refresher_.join();
+    }
+
+    void indexed_task_repository::refresh()
+    {
+        auto const started = chrono::system_clock::now();
+        std::vector<task_ptr> tasks;
+        try
+        {
+            tasks = backend_->list(task_filter::all);
+        }
+        catch (std::exception const &e)
+        {
+            std::cerr << "Task index: cannot list tasks (" << e.what() << "), keeping the previous index." << std::endl;
+            return;
+        }
+        auto next = std::make_shared<snapshot>(snapshot{bloom_filter(tasks.size(), 0.01), {}, started});
+        next->ids.reserve(tasks.size());
+        for (auto const &task : tasks)
+        {
+            auto const id = task->view()["_id"];
+            if (!id || id.type() != bsoncxx::type::k_oid)
+            {
+                continue;
+            }
+            key k;
+            std::memcpy(k.data(), id.get_oid().value.bytes(), k.size());
+            next->filter.add(std::string_view(k.data(), k.size()));
+            next->ids.push_back(k);
+        }
+        std::sort(next->ids.begin(), next->ids.end());
+        metrics().task_index_size = next->ids.size();
+        std::atomic_store(&index_, std::shared_ptr<snapshot const>(std::move(next)));
+    }
+
+    bool indexed_task_repository::may_contain(bsoncxx::oid const &id)
+    {
+        auto const index = std::atomic_load(&index_);
+        if (!index)
+        {
+            return true; // no index yet: ask the backend
+        }
+        auto const created = chrono::system_clock::from_time_t(id.get_time_t());
+        if (created >= index->built - CLOCK_SLACK && created <= chrono::system_clock::now() + CLOCK_SLACK)
+        {
+            return true; // may have been created after the index was built
+        }
+        key k;
+        std::memcpy(k.data(), id.bytes(), k.size());
+        if (!index->filter.maybe_contains(std::string_view(k.data(), k.size())))
+        {
+            ++metrics().task_index_rejected;
+            return false;
+        }
+        if (!std::binary_search(index->ids.begin(), index->ids.end(), k))
+        {
+            ++metrics().task_index_false_positives;
+            ++metrics().task_index_rejected;
+            return false;
+        }
+        return true;
+    }
+
+    task_ptr indexed_task_repository::find(bsoncxx::oid const &id)
+    {
+        return may_contain(id) ? backend_->find(id) : nullptr;
+    }
+
+    std::vector<task_ptr> indexed_task_repository::list(task_filter filter)
+    {
+        return backend_->list(filter);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_INDEXED_TASK_REPOSITORY_HPP__
+#define __STORAGE_INDEXED_TASK_REPOSITORY_HPP__
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "task_repository.hpp"
+#include "../bloom_filter.hpp"
+
+namespace storage
+{
+    // Keeps the ids of all tasks in memory, behind a Bloom filter, so that
+    // lookups of ids that do not exist (typos, bots probing random hex)
+    // are answered without a backend query. The index is rebuilt from
+    // list() periodically. Ids created after the last rebuild are
+    // recognised by the timestamp in the ObjectId and passed through to
+    // the backend, so new tasks are usable right away.
+    class indexed_task_repository : public task_repository
+    {
+    public:
+        indexed_task_repository(std::unique_ptr<task_repository> backend, std::chrono::seconds refresh_interval);
+        ~indexed_task_repository() override;
+        indexed_task_repository(indexed_task_repository const &) = delete;
+        indexed_task_repository &operator=(indexed_task_repository const &) = delete;
+
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+        bool may_contain(bsoncxx::oid const &id) override;
+
+        // Rebuilds the index; keeps the old one if the backend fails.
+        void refresh();
+
+    private:
+        typedef std::array<char, bsoncxx::oid::k_oid_length> key;
+
+        struct snapshot
+        {
+            bloom_filter filter;
+            std::vector<key> ids; // sorted
+            std::chrono::system_clock::time_point built;
+        };
+
+        std::unique_ptr<task_repository> backend_;
+        std::chrono::seconds const refresh_interval_;
+        std::shared_ptr<snapshot const> index_; // accessed with std::atomic_load/store
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        bool stop_{false};
+        std::thread refresher_;
+    };
+}
+
+#endif // __STORAGE_INDEXED_TASK_REPOSITORY_HPP__
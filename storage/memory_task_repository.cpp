@@ -0,0 +1,77 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "memory_task_repository.hpp"
+
+#include <mutex>
+#include <utility>
+
+#include <bsoncxx/types.hpp>
+
+namespace storage
+{
+    memory_task_repository::memory_task_repository(std::vector<bsoncxx::document::value> tasks)
+    {
+        for (auto &task : tasks)
+        {
+            insert(std::move(task));
+        }
+    }
+
+    bool memory_task_repository::insert(bsoncxx::document::value task)
+    {
+        auto id = task.view()["_id"];
+        if (!id || id.type() != bsoncxx::type::k_oid)
+        {
+            return false;
+        }
+        std::string key(id.get_oid().value.bytes(), bsoncxx::oid::k_oid_length);
+        auto ptr = std::make_shared<bsoncxx::document::value const>(std::move(task));
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        tasks_[std::move(key)] = std::move(ptr);
+        return true;
+    }
+
+    std::size_t memory_task_repository::size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        return tasks_.size();
+    }
+
+    task_ptr memory_task_repository::find(bsoncxx::oid const &id)
+    {
+        std::string const key(id.bytes(), bsoncxx::oid::k_oid_length);
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = tasks_.find(key);
+        return it != tasks_.end() ? it->second : nullptr;
+    }
+
+    std::vector<task_ptr> memory_task_repository::list(task_filter filter)
+    {
+        auto const now = std::chrono::system_clock::now();
+        std::vector<task_ptr> result;
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        for (auto const &[id, task] : tasks_)
+        {
+            if (matches(task->view(), filter, now))
+            {
+                result.push_back(task);
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_MEMORY_TASK_REPOSITORY_HPP__
+#define __STORAGE_MEMORY_TASK_REPOSITORY_HPP__
+
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "task_repository.hpp"
+
+namespace storage
+{
+    // Keeps all tasks in memory, e.g. for tests, benchmarks or grading
+    // nodes without database access.
+    class memory_task_repository : public task_repository
+    {
+    public:
+        memory_task_repository() = default;
+        explicit memory_task_repository(std::vector<bsoncxx::document::value> tasks);
+
+        // Adds or replaces a task. Tasks without an ObjectId "_id" are ignored.
+        bool insert(bsoncxx::document::value task);
+        std::size_t size() const;
+
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+
+    private:
+        std::unordered_map<std::string, task_ptr> tasks_;
+        mutable std::shared_mutex mtx_;
+    };
+}
+
+#endif // __STORAGE_MEMORY_TASK_REPOSITORY_HPP__
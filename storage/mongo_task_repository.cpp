@@ -0,0 +1,100 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mongo_task_repository.hpp"
+
+#include <utility>
+
+#include <mongocxx/client.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/cursor.hpp>
+#include <mongocxx/options/find.hpp>
+#include <bsoncxx/builder/stream/helpers.hpp>
+#include <bsoncxx/builder/stream/document.hpp>
+#include <bsoncxx/types.hpp>
+
+namespace storage
+{
+    mongo_task_repository::mongo_task_repository(mongocxx::uri const &uri, std::string database, std::string collection)
+        : pool_(uri)
+        , database_(std::move(database))
+        , collection_(std::move(collection))
+    {
+    }
+
+    task_ptr mongo_task_repository::find(bsoncxx::oid const &id)
+    {
+        auto client = pool_.acquire();
+        mongocxx::collection coll = (*client)[database_][collection_];
+        auto query = bsoncxx::builder::stream::document{}
+                     << "_id"
+                     << id
+                     << bsoncxx::builder::stream::finalize;
+        auto result = coll.find_one(std::move(query));
+        if (!result)
+        {
+            return nullptr;
+        }
+        return std::make_shared<bsoncxx::document::value const>(std::move(*result));
+    }
+
+    std::vector<task_ptr> mongo_task_repository::list(task_filter filter)
+    {
+        bsoncxx::document::value query = bsoncxx::builder::stream::document{} << bsoncxx::builder::stream::finalize;
+        if (filter == task_filter::current)
+        {
+            query = bsoncxx::builder::stream::document{}
+                   << "valid.from"
+                   << bsoncxx::builder::stream::open_document
+                   << "$lte"
+                   << bsoncxx::types::b_date{std::chrono::system_clock::now()}
+                   << bsoncxx::builder::stream::close_document
+                   << "valid.until"
+                   << bsoncxx::builder::stream::open_document
+                   << "$gt"
+                   << bsoncxx::types::b_date{std::chrono::system_clock::now()}
+                   << bsoncxx::builder::stream::close_document
+                   << bsoncxx::builder::stream::finalize;
+        }
+        else if (filter == task_filter::archived)
+        {
+            query = bsoncxx::builder::stream::document{}
+                   << "valid.until"
+                   << bsoncxx::builder::stream::open_document
+                   << "$lt"
+                   << bsoncxx::types::b_date{std::chrono::system_clock::now()}
+                   << bsoncxx::builder::stream::close_document
+                   << bsoncxx::builder::stream::finalize;
+        }
+        mongocxx::options::find opts{};
+        opts.projection(bsoncxx::builder::stream::document{}
+                        << "name"
+                        << 1
+                        << "task"
+                        << 1
+                        << bsoncxx::builder::stream::finalize);
+        auto client = pool_.acquire();
+        mongocxx::collection coll = (*client)[database_][collection_];
+        mongocxx::cursor cursor = coll.find(std::move(query), opts);
+        std::vector<task_ptr> tasks;
+        for (auto const &task : cursor)
+        {
+            tasks.push_back(std::make_shared<bsoncxx::document::value const>(task));
+        }
+        return tasks;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_MONGO_TASK_REPOSITORY_HPP__
+#define __STORAGE_MONGO_TASK_REPOSITORY_HPP__
+
+#include <string>
+
+#include <mongocxx/pool.hpp>
+#include <mongocxx/uri.hpp>
+
+#include "task_repository.hpp"
+
+namespace storage
+{
+    class mongo_task_repository : public task_repository
+    {
+    public:
+        mongo_task_repository(mongocxx::uri const &uri, std::string database, std::string collection);
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+
+    private:
+        mongocxx::pool pool_;
+        std::string const database_;
+        std::string const collection_;
+    };
+}
+
+#endif // __STORAGE_MONGO_TASK_REPOSITORY_HPP__
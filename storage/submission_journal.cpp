@@ -0,0 +1,196 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "submission_journal.hpp"
+
+#include <iostream>
+#include <utility>
+
+#include <bsoncxx/json.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/exception/exception.hpp>
+
+#include "../metrics.hpp"
+
+namespace storage
+{
+    namespace
+    {
+        bsoncxx::document::value to_document(submission const &s)
+        {
+            using bsoncxx::builder::basic::kvp;
+            return bsoncxx::builder::basic::make_document(
+                kvp("task_id", s.task_id),
+                kvp("email", s.email),
+                kvp("correct", s.correct),
+                kvp("elapsed_msecs", s.elapsed_msecs),
+                kvp("cpu_msecs", s.cpu_msecs),
+                kvp("script_hash", s.script_hash),
+                kvp("submitted", bsoncxx::types::b_date{s.submitted}));
+        }
+    }
+
+    submission_journal::submission_journal(std::optional<mongocxx::uri> uri, std::string database, std::string collection, submission_journal_config config)
+        : uri_(std::move(uri))
+        , database_(std::move(database))
+        , collection_(std::move(collection))
+        , config_(std::move(config))
+    {
+        flusher_ = std::thread([this]
+                               { run(); });
+    }
+
+    submission_journal::~submission_journal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        flusher_.join();
+    }
+
+    bool submission_journal::record(submission s)
+    {
+        std::size_t depth;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (queue_.size() >= config_.capacity)
+            {
+                ++metrics().journal_dropped;
+                return false;
+            }
+            queue_.push_back(std::move(s));
+            depth = queue_.size();
+        }
+        metrics().journal_queue_depth = depth;
+        if (depth >= config_.batch_size)
+        {
+            cv_.notify_one();
+        }
+        return true;
+    }
+
+    std::size_t submission_journal::queue_depth() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return queue_.size();
+    }
+
+    void submission_journal::run()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        for (;;)
+        {
+            cv_.wait_for(lock, config_.flush_interval, [this]
+                         { return stop_ || queue_.size() >= config_.batch_size; });
+            while (!queue_.empty())
+            {
+                std::size_t const n = std::min(queue_.size(), config_.batch_size);
+                std::vector<submission> batch(std::make_move_iterator(queue_.begin()),
+                                              std::make_move_iterator(queue_.begin() + static_cast<std::ptrdiff_t>(n)));
+                queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(n));
+                metrics().journal_queue_depth = queue_.size();
+                lock.unlock();
+                flush(batch);
+                lock.lock();
+                if (!stop_ && queue_.size() < config_.batch_size)
+                {
+                    break;
+                }
+            }
+            if (stop_ && queue_.empty())
+            {
+                return;
+            }
+        }
+    }
+
+    void submission_journal::flush(std::vector<submission> const &batch)
+    {
+        if (write_to_db(batch))
+        {
+            metrics().journal_written_db += batch.size();
+        }
+        else if (write_to_file(batch))
+        {
+            metrics().journal_written_file += batch.size();
+        }
+        else
+        {
+            metrics().journal_dropped += batch.size();
+        }
+    }
+
+    bool submission_journal::write_to_db(std::vector<submission> const &batch)
+    {
+        if (!uri_ || std::chrono::steady_clock::now() < db_retry_at_)
+        {
+            return false;
+        }
+        std::vector<bsoncxx::document::value> docs;
+        docs.reserve(batch.size());
+        for (auto const &s : batch)
+        {
+            docs.push_back(to_document(s));
+        }
+        try
+        {
+            if (!client_)
+            {
+                client_.emplace(*uri_);
+            }
+            mongocxx::collection coll = (*client_)[database_][collection_];
+            coll.insert_many(docs);
+            return true;
+        }
+        catch (mongocxx::exception const &e)
+        {
+            std::cerr << "Submission journal: cannot write to database (" << e.what() << "), "
+                      << "retrying in " << config_.db_retry_interval.count() << "s." << std::endl;
+            db_retry_at_ = std::chrono::steady_clock::now() + config_.db_retry_interval;
+            return false;
+        }
+    }
+
+    bool submission_journal::write_to_file(std::vector<submission> const &batch)
+    {
+        if (config_.fallback_path.empty())
+        {
+            return false;
+        }
+        if (!fallback_.is_open())
+        {
+            fallback_.open(config_.fallback_path, std::ios::app);
+        }
+        for (auto const &s : batch)
+        {
+            fallback_ << bsoncxx::to_json(to_document(s)) << '\n';
+        }
+        fallback_.flush();
+        if (!fallback_)
+        {
+            fallback_.close();
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_SUBMISSION_JOURNAL_HPP__
+#define __STORAGE_SUBMISSION_JOURNAL_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bsoncxx/oid.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/uri.hpp>
+
+namespace storage
+{
+    struct submission
+    {
+        bsoncxx::oid task_id;
+        std::string email;
+        bool correct;
+        double elapsed_msecs;
+        double cpu_msecs;
+        std::string script_hash;
+        std::chrono::system_clock::time_point submitted;
+    };
+
+    struct submission_journal_config
+    {
+        std::size_t capacity{10000};
+        std::size_t batch_size{100};
+        std::chrono::milliseconds flush_interval{1000};
+        std::chrono::seconds db_retry_interval{30};
+        std::string fallback_path;
+    };
+
+    // Write-behind journal of submissions: record() only enqueues, a
+    // background thread writes the queue to MongoDB with insert_many() in
+    // batches. While the database is unreachable, batches are appended to
+    // a JSON lines file instead. If the queue is full, records are dropped
+    // and counted rather than slowing down the request.
+    class submission_journal
+    {
+    public:
+        submission_journal(std::optional<mongocxx::uri> uri, std::string database, std::string collection, submission_journal_config config);
+        ~submission_journal();
+        submission_journal(submission_journal const &) = delete;
+        submission_journal &operator=(submission_journal const &) = delete;
+
+        // Returns false if the record had to be dropped.
+        bool record(submission s);
+        std::size_t queue_depth() const;
+
+    private:
+        std::optional<mongocxx::uri> const uri_;
+        std::string const database_;
+        std::string const collection_;
+        submission_journal_config const config_;
+        std::deque<submission> queue_;
+        mutable std::mutex mtx_;
+        std::condition_variable cv_;
+        bool stop_{false};
+        std::optional<mongocxx::client> client_; // only used by the flusher thread
+        std::ofstream fallback_;
+        std::chrono::steady_clock::time_point db_retry_at_{};
+        std::thread flusher_;
+
+        void run();
+        void flush(std::vector<submission> const &batch);
+        bool write_to_db(std::vector<submission> const &batch);
+        bool write_to_file(std::vector<submission> const &batch);
+    };
+}
+
+#endif // __STORAGE_SUBMISSION_JOURNAL_HPP__
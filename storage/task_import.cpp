@@ -0,0 +1,108 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "task_import.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <bsoncxx/json.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/document/view.hpp>
+
+namespace storage
+{
+    namespace
+    {
+        std::string read_file(std::string const &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+            {
+                throw std::runtime_error("cannot open " + path);
+            }
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        bool ends_with(std::string const &s, std::string const &suffix)
+        {
+            return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        std::vector<bsoncxx::document::value> read_bson(std::string const &data)
+        {
+            std::vector<bsoncxx::document::value> docs;
+            std::size_t pos = 0;
+            while (pos < data.size())
+            {
+                std::int32_t length;
+                if (data.size() - pos < sizeof(length))
+                {
+                    throw std::runtime_error("truncated BSON document");
+                }
+                std::memcpy(&length, data.data() + pos, sizeof(length));
+                if (length < 5 || static_cast<std::size_t>(length) > data.size() - pos)
+                {
+                    throw std::runtime_error("invalid BSON document length");
+                }
+                bsoncxx::document::view view(reinterpret_cast<std::uint8_t const *>(data.data() + pos), static_cast<std::size_t>(length));
+                docs.emplace_back(view);
+                pos += static_cast<std::size_t>(length);
+            }
+            return docs;
+        }
+
+        std::vector<bsoncxx::document::value> read_json(std::string const &data)
+        {
+            std::vector<bsoncxx::document::value> docs;
+            auto first = data.find_first_not_of(" \t\r\n");
+            if (first != std::string::npos && data[first] == '[')
+            {
+                auto wrapper = bsoncxx::from_json("{\"tasks\":" + data + "}");
+                for (auto const &element : wrapper.view()["tasks"].get_array().value)
+                {
+                    if (element.type() != bsoncxx::type::k_document)
+                    {
+                        throw std::runtime_error("array element is not a document");
+                    }
+                    docs.emplace_back(element.get_document().value);
+                }
+                return docs;
+            }
+            std::istringstream in(data);
+            std::string line;
+            while (std::getline(in, line))
+            {
+                if (line.find_first_not_of(" \t\r") != std::string::npos)
+                {
+                    docs.push_back(bsoncxx::from_json(line));
+                }
+            }
+            return docs;
+        }
+    }
+
+    std::vector<bsoncxx::document::value> read_task_export(std::string const &path)
+    {
+        std::string const data = read_file(path);
+        return ends_with(path, ".bson") ? read_bson(data) : read_json(data);
+    }
+}
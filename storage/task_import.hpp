@@ -0,0 +1,35 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_TASK_IMPORT_HPP__
+#define __STORAGE_TASK_IMPORT_HPP__
+
+#include <string>
+#include <vector>
+
+#include <bsoncxx/document/value.hpp>
+
+namespace storage
+{
+    // Reads a task collection export: either concatenated BSON documents
+    // (mongodump, *.bson) or extended JSON (mongoexport), as one document
+    // per line or as a single array. Throws std::runtime_error or
+    // bsoncxx::exception on malformed input.
+    extern std::vector<bsoncxx::document::value> read_task_export(std::string const &path);
+}
+
+#endif // __STORAGE_TASK_IMPORT_HPP__
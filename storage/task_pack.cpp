@@ -0,0 +1,220 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "task_pack.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/document/view.hpp>
+
+namespace storage
+{
+    namespace
+    {
+        constexpr std::uint64_t align8(std::uint64_t n)
+        {
+            return (n + 7U) & ~std::uint64_t{7U};
+        }
+
+        bool oid_less(pack_index_entry const &entry, std::uint8_t const *oid)
+        {
+            return std::memcmp(entry.oid, oid, sizeof(entry.oid)) < 0;
+        }
+    }
+
+    void write_task_pack(std::string const &path, std::vector<bsoncxx::document::value> const &tasks)
+    {
+        std::vector<pack_index_entry> index;
+        index.reserve(tasks.size());
+        std::uint64_t offset = sizeof(pack_header) + tasks.size() * sizeof(pack_index_entry);
+        std::vector<std::size_t> order;
+        for (std::size_t i = 0; i < tasks.size(); ++i)
+        {
+            auto id = tasks[i].view()["_id"];
+            if (!id || id.type() != bsoncxx::type::k_oid)
+            {
+                throw std::runtime_error("task #" + std::to_string(i) + " has no ObjectId in field \"_id\"");
+            }
+            pack_index_entry entry{};
+            std::memcpy(entry.oid, id.get_oid().value.bytes(), sizeof(entry.oid));
+            entry.length = static_cast<std::uint32_t>(tasks[i].view().length());
+            offset = align8(offset);
+            entry.offset = offset;
+            offset += entry.length;
+            index.push_back(entry);
+            order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(),
+                  [&index](std::size_t a, std::size_t b)
+                  { return std::memcmp(index[a].oid, index[b].oid, sizeof(index[a].oid)) < 0; });
+        for (std::size_t i = 1; i < order.size(); ++i)
+        {
+            if (std::memcmp(index[order[i - 1]].oid, index[order[i]].oid, sizeof(pack_index_entry::oid)) == 0)
+            {
+                throw std::runtime_error("duplicate task id in input");
+            }
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("cannot create " + path);
+        }
+        pack_header header{};
+        std::memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+        header.version = PACK_VERSION;
+        header.count = static_cast<std::uint32_t>(tasks.size());
+        header.file_size = offset;
+        out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        for (std::size_t i : order)
+        {
+            out.write(reinterpret_cast<char const *>(&index[i]), sizeof(pack_index_entry));
+        }
+        static char const padding[8] = {};
+        std::uint64_t pos = sizeof(pack_header) + tasks.size() * sizeof(pack_index_entry);
+        for (std::size_t i = 0; i < tasks.size(); ++i)
+        {
+            out.write(padding, static_cast<std::streamsize>(index[i].offset - pos));
+            out.write(reinterpret_cast<char const *>(tasks[i].view().data()), index[i].length);
+            pos = index[i].offset + index[i].length;
+        }
+        if (!out)
+        {
+            throw std::runtime_error("failed to write " + path);
+        }
+    }
+
+    task_pack_repository::task_pack_repository(std::string const &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(pack_header))
+        {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a task pack");
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            throw std::runtime_error("cannot map " + path + ": " + std::strerror(errno));
+        }
+        data_ = static_cast<std::uint8_t *>(addr);
+        ::madvise(data_, size_, MADV_WILLNEED);
+
+        pack_header const *header = reinterpret_cast<pack_header const *>(data_);
+        if (std::memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != PACK_VERSION ||
+            header->file_size != size_ ||
+            sizeof(pack_header) + std::uint64_t{header->count} * sizeof(pack_index_entry) > size_)
+        {
+            ::munmap(data_, size_);
+            throw std::runtime_error(path + " is not a valid task pack");
+        }
+        count_ = header->count;
+        index_ = reinterpret_cast<pack_index_entry const *>(data_ + sizeof(pack_header));
+        for (std::uint32_t i = 0; i < count_; ++i)
+        {
+            // bsoncxx trusts the length prefix of a document, so it has to
+            // agree with the index, and the document has to lie within the
+            // mapping (without overflowing offset + length)
+            pack_index_entry const &entry = index_[i];
+            bool valid = entry.length >= 5 && entry.offset <= size_ && entry.length <= size_ - entry.offset;
+            if (valid)
+            {
+                std::uint8_t const *doc = data_ + entry.offset;
+                std::uint32_t const prefix = std::uint32_t{doc[0]} |
+                                             std::uint32_t{doc[1]} << 8 |
+                                             std::uint32_t{doc[2]} << 16 |
+                                             std::uint32_t{doc[3]} << 24;
+                valid = prefix == entry.length && doc[entry.length - 1] == 0;
+            }
+            // find() bisects the index: it must be sorted, without
+            // duplicates, and each entry must lead to the task it names
+            valid = valid && (i == 0 || oid_less(index_[i - 1], entry.oid));
+            if (valid)
+            {
+                auto const id = bsoncxx::document::view(data_ + entry.offset, entry.length)["_id"];
+                valid = id && id.type() == bsoncxx::type::k_oid &&
+                        std::memcmp(id.get_oid().value.bytes(), entry.oid, sizeof(entry.oid)) == 0;
+            }
+            if (!valid)
+            {
+                ::munmap(data_, size_);
+                throw std::runtime_error(path + " contains a corrupt index entry");
+            }
+        }
+    }
+
+    task_pack_repository::~task_pack_repository()
+    {
+        ::munmap(data_, size_);
+    }
+
+    std::size_t task_pack_repository::size() const
+    {
+        return count_;
+    }
+
+    task_ptr task_pack_repository::make_task(pack_index_entry const &entry) const
+    {
+        return std::make_shared<bsoncxx::document::value const>(
+            data_ + entry.offset, entry.length, [](std::uint8_t *) {});
+    }
+
+    task_ptr task_pack_repository::find(bsoncxx::oid const &id)
+    {
+        auto const *oid = reinterpret_cast<std::uint8_t const *>(id.bytes());
+        pack_index_entry const *end = index_ + count_;
+        pack_index_entry const *entry = std::lower_bound(index_, end, oid, oid_less);
+        if (entry == end || std::memcmp(entry->oid, oid, sizeof(entry->oid)) != 0)
+        {
+            return nullptr;
+        }
+        return make_task(*entry);
+    }
+
+    std::vector<task_ptr> task_pack_repository::list(task_filter filter)
+    {
+        auto const now = std::chrono::system_clock::now();
+        std::vector<task_ptr> result;
+        for (std::uint32_t i = 0; i < count_; ++i)
+        {
+            bsoncxx::document::view task(data_ + index_[i].offset, index_[i].length);
+            if (matches(task, filter, now))
+            {
+                result.push_back(make_task(index_[i]));
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_TASK_PACK_HPP__
+#define __STORAGE_TASK_PACK_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "task_repository.hpp"
+
+namespace storage
+{
+    // A task pack is a read-only file holding the BSON documents of a task
+    // collection, preceded by an index sorted by ObjectId:
+    //
+    //   pack_header | pack_index_entry[count] | BSON documents (8-byte aligned)
+    //
+    // All integers are little-endian, like BSON itself.
+    struct pack_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t count;
+        std::uint64_t file_size;
+        std::uint64_t reserved;
+    };
+
+    struct pack_index_entry
+    {
+        std::uint8_t oid[12];
+        std::uint32_t length;
+        std::uint64_t offset;
+    };
+
+    static_assert(sizeof(pack_header) == 32);
+    static_assert(sizeof(pack_index_entry) == 24);
+
+    constexpr char PACK_MAGIC[8] = {'A', 'N', 'G', 'L', 'P', 'A', 'C', 'K'};
+    constexpr std::uint32_t PACK_VERSION = 1;
+
+    // Throws std::runtime_error if the pack cannot be written or a task has no ObjectId.
+    extern void write_task_pack(std::string const &path, std::vector<bsoncxx::document::value> const &tasks);
+
+    // Serves tasks straight out of a memory-mapped task pack. Documents are
+    // handed out without being copied; the mapping lives as long as the
+    // repository.
+    class task_pack_repository : public task_repository
+    {
+    public:
+        // Throws std::runtime_error if the file cannot be mapped or is malformed.
+        explicit task_pack_repository(std::string const &path);
+        ~task_pack_repository();
+        task_pack_repository(task_pack_repository const &) = delete;
+        task_pack_repository &operator=(task_pack_repository const &) = delete;
+
+        std::size_t size() const;
+        task_ptr find(bsoncxx::oid const &id) override;
+        std::vector<task_ptr> list(task_filter filter) override;
+
+    private:
+        std::uint8_t *data_{nullptr};
+        std::size_t size_{0};
+        pack_index_entry const *index_{nullptr};
+        std::uint32_t count_{0};
+
+        task_ptr make_task(pack_index_entry const &entry) const;
+    };
+}
+
+#endif // __STORAGE_TASK_PACK_HPP__
@@ -0,0 +1,58 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "task_repository.hpp"
+
+#include <bsoncxx/types.hpp>
+
+namespace storage
+{
+    namespace
+    {
+        bool get_date(bsoncxx::document::view valid, char const *key, std::chrono::system_clock::time_point &date)
+        {
+            auto element = valid[key];
+            if (!element || element.type() != bsoncxx::type::k_date)
+            {
+                return false;
+            }
+            date = std::chrono::system_clock::time_point(element.get_date().value);
+            return true;
+        }
+    }
+
+    bool matches(bsoncxx::document::view task, task_filter filter, std::chrono::system_clock::time_point now)
+    {
+        if (filter == task_filter::all)
+        {
+            return true;
+        }
+        auto valid = task["valid"];
+        if (!valid || valid.type() != bsoncxx::type::k_document)
+        {
+            return false;
+        }
+        std::chrono::system_clock::time_point from;
+        std::chrono::system_clock::time_point until;
+        bool const has_until = get_date(valid.get_document().value, "until", until);
+        if (filter == task_filter::archived)
+        {
+            return has_until && until < now;
+        }
+        return get_date(valid.get_document().value, "from", from) && has_until && from <= now && now < until;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STORAGE_TASK_REPOSITORY_HPP__
+#define __STORAGE_TASK_REPOSITORY_HPP__
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+
+namespace storage
+{
+    typedef std::shared_ptr<bsoncxx::document::value const> task_ptr;
+
+    enum class task_filter
+    {
+        all,
+        current,
+        archived
+    };
+
+    // Read access to the tasks, regardless of where they are kept.
+    // Implementations must be safe to use from several threads at once.
+    class task_repository
+    {
+    public:
+        virtual ~task_repository() = default;
+
+        // Returns nullptr if there is no task with the given id.
+        virtual task_ptr find(bsoncxx::oid const &id) = 0;
+
+        // Returns the tasks matching the filter. Backends may leave out
+        // fields not needed for listing (e.g. "tests").
+        virtual std::vector<task_ptr> list(task_filter filter) = 0;
+
+        // Returns false only if there certainly is no task with the given
+        // id. Must be cheap; implementations that cannot tell without a
+        // query answer true.
+        virtual bool may_contain(bsoncxx::oid const &) { return true; }
+    };
+
+    // Evaluates the "valid.from"/"valid.until" window the same way the
+    // MongoDB queries of the database backend do.
+    extern bool matches(bsoncxx::document::view task, task_filter filter, std::chrono::system_clock::time_point now);
+}
+
+#endif // __STORAGE_TASK_REPOSITORY_HPP__
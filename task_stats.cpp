@@ -0,0 +1,283 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "task_stats.hpp"
+
+namespace pt = boost::property_tree;
+
+namespace
+{
+    constexpr double HISTOGRAM_BASE_MSECS = 0.01;
+    constexpr double HISTOGRAM_GROWTH = 1.2;
+    // Version 1 snapshots had no version and held wall-clock times; version
+    // 2 holds CPU times.
+    constexpr int SNAPSHOT_VERSION = 2;
+
+    std::size_t shard_index()
+    {
+        static std::atomic<std::size_t> next{0};
+        thread_local std::size_t const index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+}
+
+void sharded_counter::add(std::uint64_t n)
+{
+    shards_[shard_index() % SHARDS].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+std::uint64_t sharded_counter::load() const
+{
+    std::uint64_t sum = 0;
+    for (auto const &s : shards_)
+    {
+        sum += s.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void cpu_time_histogram::add(double cpu_msecs)
+{
+    std::size_t i = 0;
+    if (cpu_msecs > HISTOGRAM_BASE_MSECS)
+    {
+        i = std::min(BUCKETS - 1, static_cast<std::size_t>(std::ceil(std::log(cpu_msecs / HISTOGRAM_BASE_MSECS) / std::log(HISTOGRAM_GROWTH))));
+    }
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+double cpu_time_histogram::percentile(double p) const
+{
+    std::array<std::uint64_t, BUCKETS> counts;
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    std::uint64_t const total = std::accumulate(counts.cbegin(), counts.cend(), std::uint64_t{0});
+    if (total == 0)
+    {
+        return 0.0;
+    }
+    auto const rank = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return HISTOGRAM_BASE_MSECS * std::pow(HISTOGRAM_GROWTH, static_cast<double>(i));
+        }
+    }
+    return HISTOGRAM_BASE_MSECS * std::pow(HISTOGRAM_GROWTH, static_cast<double>(BUCKETS - 1));
+}
+
+std::uint64_t cpu_time_histogram::bucket(std::size_t i) const
+{
+    return buckets_[i].load(std::memory_order_relaxed);
+}
+
+void cpu_time_histogram::add_to_bucket(std::size_t i, std::uint64_t count)
+{
+    buckets_[i].fetch_add(count, std::memory_order_relaxed);
+}
+
+void task_stats::record(std::string const &email, bool correct, double cpu_msecs)
+{
+    attempts_.add();
+    histogram_.add(cpu_msecs);
+    if (!correct)
+    {
+        return;
+    }
+    passed_.add();
+    if (!email.empty() && cpu_msecs < admission_limit_.load(std::memory_order_relaxed))
+    {
+        update_leaderboard(email, cpu_msecs);
+    }
+}
+
+void task_stats::update_leaderboard(std::string const &email, double cpu_msecs)
+{
+    std::lock_guard<std::mutex> lock(leaderboard_mtx_);
+    auto it = std::find_if(leaderboard_.begin(), leaderboard_.end(),
+                           [&email](leaderboard_entry const &e)
+                           { return e.email == email; });
+    if (it != leaderboard_.end())
+    {
+        if (cpu_msecs >= it->cpu_msecs)
+        {
+            return;
+        }
+        leaderboard_.erase(it);
+    }
+    else if (leaderboard_.size() >= LEADERBOARD_SIZE)
+    {
+        if (cpu_msecs >= leaderboard_.back().cpu_msecs)
+        {
+            return;
+        }
+        leaderboard_.pop_back();
+    }
+    auto pos = std::upper_bound(leaderboard_.begin(), leaderboard_.end(), cpu_msecs,
+                                [](double t, leaderboard_entry const &e)
+                                { return t < e.cpu_msecs; });
+    leaderboard_.insert(pos, leaderboard_entry{email, cpu_msecs});
+    admission_limit_.store(leaderboard_.size() >= LEADERBOARD_SIZE
+                               ? leaderboard_.back().cpu_msecs
+                               : std::numeric_limits<double>::infinity(),
+                           std::memory_order_relaxed);
+}
+
+std::uint64_t task_stats::attempts() const
+{
+    return attempts_.load();
+}
+
+std::uint64_t task_stats::passed() const
+{
+    return passed_.load();
+}
+
+double task_stats::percentile(double p) const
+{
+    return histogram_.percentile(p);
+}
+
+std::vector<leaderboard_entry> task_stats::leaderboard() const
+{
+    std::lock_guard<std::mutex> lock(leaderboard_mtx_);
+    return leaderboard_;
+}
+
+task_stats &stats_registry::get(std::string const &task_id)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = tasks_.find(task_id);
+        if (it != tasks_.end())
+        {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    auto &stats = tasks_[task_id];
+    if (!stats)
+    {
+        stats = std::make_unique<task_stats>();
+    }
+    return *stats;
+}
+
+void stats_registry::record(std::string const &task_id, std::string const &email, bool correct, double cpu_msecs)
+{
+    get(task_id).record(email, correct, cpu_msecs);
+}
+
+task_stats const *stats_registry::find(std::string const &task_id) const
+{
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    auto it = tasks_.find(task_id);
+    return it != tasks_.end() ? it->second.get() : nullptr;
+}
+
+void stats_registry::save(std::string const &path) const
+{
+    pt::ptree tasks;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        for (auto const &[task_id, stats] : tasks_)
+        {
+            pt::ptree task;
+            task.put("attempts", stats->attempts());
+            task.put("passed", stats->passed());
+            pt::ptree histogram;
+            for (std::size_t i = 0; i < cpu_time_histogram::BUCKETS; ++i)
+            {
+                pt::ptree bucket;
+                bucket.put("", stats->histogram_.bucket(i));
+                histogram.push_back(std::make_pair("", bucket));
+            }
+            task.add_child("histogram", histogram);
+            pt::ptree leaderboard;
+            for (auto const &entry : stats->leaderboard())
+            {
+                pt::ptree e;
+                e.put("email", entry.email);
+                e.put("cpu_msecs", entry.cpu_msecs);
+                leaderboard.push_back(std::make_pair("", e));
+            }
+            task.add_child("leaderboard", leaderboard);
+            tasks.add_child(pt::ptree::path_type(task_id, '\0'), task);
+        }
+    }
+    pt::ptree root;
+    root.put("version", SNAPSHOT_VERSION);
+    root.add_child("tasks", tasks);
+    std::string const tmp_path = path + ".tmp";
+    pt::write_json(tmp_path, root, std::locale(), false);
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("cannot rename " + tmp_path + " to " + path);
+    }
+}
+
+void stats_registry::load(std::string const &path)
+{
+    pt::ptree root;
+    pt::read_json(path, root);
+    int const version = root.get<int>("version", 1);
+    if (version > SNAPSHOT_VERSION)
+    {
+        throw std::runtime_error("unknown snapshot version " + std::to_string(version));
+    }
+    // get_child() returns the default itself when the key is missing, so
+    // the default has to outlive the loops
+    pt::ptree const none;
+    // the counts of a version 1 snapshot still hold, its times do not
+    // mix with CPU times: it starts a new histogram and leaderboard
+    pt::ptree const &tasks = version == 1 ? root : root.get_child("tasks", none);
+    for (auto const &[task_id, task] : tasks)
+    {
+        task_stats &stats = get(task_id);
+        stats.attempts_.add(task.get<std::uint64_t>("attempts", 0));
+        stats.passed_.add(task.get<std::uint64_t>("passed", 0));
+        if (version == 1)
+        {
+            continue;
+        }
+        std::size_t i = 0;
+        for (auto const &bucket : task.get_child("histogram", none))
+        {
+            if (i < cpu_time_histogram::BUCKETS)
+            {
+                stats.histogram_.add_to_bucket(i++, bucket.second.get_value<std::uint64_t>());
+            }
+        }
+        for (auto const &entry : task.get_child("leaderboard", none))
+        {
+            stats.update_leaderboard(entry.second.get<std::string>("email"), entry.second.get<double>("cpu_msecs"));
+        }
+    }
+}
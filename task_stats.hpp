@@ -0,0 +1,118 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TASK_STATS_HPP__
+#define __TASK_STATS_HPP__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counter split over several cache lines, so that threads recording
+// verdicts for the same task don't fight over a single one.
+class sharded_counter
+{
+public:
+    void add(std::uint64_t n = 1);
+    std::uint64_t load() const;
+
+private:
+    static constexpr std::size_t SHARDS = 16;
+    struct alignas(64) shard
+    {
+        std::atomic<std::uint64_t> value{0};
+    };
+    std::array<shard, SHARDS> shards_;
+};
+
+// CPU time histogram with logarithmic buckets (each ~20% wider than
+// the previous one), good enough to tell p50 and p95.
+class cpu_time_histogram
+{
+public:
+    static constexpr std::size_t BUCKETS = 64;
+
+    void add(double cpu_msecs);
+    double percentile(double p) const;
+    std::uint64_t bucket(std::size_t i) const;
+    void add_to_bucket(std::size_t i, std::uint64_t count);
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> buckets_{};
+};
+
+struct leaderboard_entry
+{
+    std::string email;
+    double cpu_msecs;
+};
+
+class task_stats
+{
+public:
+    static constexpr std::size_t LEADERBOARD_SIZE = 10;
+
+    void record(std::string const &email, bool correct, double cpu_msecs);
+    std::uint64_t attempts() const;
+    std::uint64_t passed() const;
+    double percentile(double p) const;
+    std::vector<leaderboard_entry> leaderboard() const;
+
+private:
+    friend class stats_registry;
+    sharded_counter attempts_;
+    sharded_counter passed_;
+    cpu_time_histogram histogram_;
+    std::vector<leaderboard_entry> leaderboard_; // sorted, fastest first
+    std::atomic<double> admission_limit_{std::numeric_limits<double>::infinity()};
+    mutable std::mutex leaderboard_mtx_;
+
+    void update_leaderboard(std::string const &email, double cpu_msecs);
+};
+
+// Statistics of all tasks, updated as verdicts come in.
+class stats_registry
+{
+public:
+    void record(std::string const &task_id, std::string const &email, bool correct, double cpu_msecs);
+    // Returns nullptr if nothing has been recorded for the task yet.
+    task_stats const *find(std::string const &task_id) const;
+
+    // Snapshots are JSON files; save() replaces the file atomically,
+    // load() adds the snapshot to what has been recorded so far, e.g. by a
+    // server that took over while its predecessor was still recording.
+    // Both throw on I/O or parse errors.
+    void save(std::string const &path) const;
+    void load(std::string const &path);
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<task_stats>> tasks_;
+    mutable std::shared_mutex mtx_;
+
+    task_stats &get(std::string const &task_id);
+};
+
+#endif // __TASK_STATS_HPP__
@@ -0,0 +1,79 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+
+#include "test_order.hpp"
+
+std::vector<std::size_t> test_order_registry::order(std::string const &task_id, std::size_t num_tests) const
+{
+    std::vector<std::size_t> indices(num_tests);
+    std::iota(indices.begin(), indices.end(), 0U);
+    std::shared_ptr<failure_counts> failures;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = tasks_.find(task_id);
+        if (it != tasks_.end())
+        {
+            failures = it->second;
+        }
+    }
+    if (!failures || failures->size != num_tests)
+    {
+        return indices;
+    }
+    std::vector<std::uint64_t> counts(num_tests);
+    for (std::size_t i = 0; i < num_tests; ++i)
+    {
+        counts[i] = failures->counts[i].load(std::memory_order_relaxed);
+    }
+    // stable, so that tests without failures keep their original order
+    std::stable_sort(indices.begin(), indices.end(),
+                     [&counts](std::size_t a, std::size_t b)
+                     { return counts[a] > counts[b]; });
+    return indices;
+}
+
+void test_order_registry::record_failure(std::string const &task_id, std::size_t num_tests, std::size_t test_index)
+{
+    std::shared_ptr<failure_counts> failures;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        auto it = tasks_.find(task_id);
+        if (it != tasks_.end() && it->second->size == num_tests)
+        {
+            failures = it->second;
+        }
+    }
+    if (!failures)
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        auto &entry = tasks_[task_id];
+        // (re)create if the task's tests have changed in the meantime
+        if (!entry || entry->size != num_tests)
+        {
+            entry = std::make_shared<failure_counts>(num_tests);
+        }
+        failures = entry;
+    }
+    if (test_index < failures->size)
+    {
+        failures->counts[test_index].fetch_add(1, std::memory_order_relaxed);
+    }
+}
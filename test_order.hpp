@@ -0,0 +1,53 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEST_ORDER_HPP__
+#define __TEST_ORDER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Remembers per task which test vectors catch wrong submissions most
+// often, so that they can be run first and wrong answers fail fast.
+class test_order_registry
+{
+public:
+    // Returns the test indices 0..num_tests-1, most discriminating first.
+    std::vector<std::size_t> order(std::string const &task_id, std::size_t num_tests) const;
+    void record_failure(std::string const &task_id, std::size_t num_tests, std::size_t test_index);
+
+private:
+    struct failure_counts
+    {
+        explicit failure_counts(std::size_t n)
+            : size(n), counts(new std::atomic<std::uint64_t>[n]())
+        {
+        }
+        std::size_t const size;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+    };
+    std::unordered_map<std::string, std::shared_ptr<failure_counts>> tasks_;
+    mutable std::shared_mutex mtx_;
+};
+
+#endif // __TEST_ORDER_HPP__
@@ -0,0 +1,83 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../bloom_filter.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(std::string const &name, bool ok, std::string const &detail = "")
+    {
+        if (!ok)
+        {
+            ++failures;
+            std::cerr << "FAIL " << name << (detail.empty() ? "" : ": " + detail) << std::endl;
+        }
+    }
+
+    std::string key(char const *prefix, std::size_t i)
+    {
+        return prefix + std::to_string(i);
+    }
+}
+
+int main()
+{
+    constexpr std::size_t KEYS = 10000;
+    constexpr std::size_t PROBES = 100000;
+
+    for (double const rate : {0.01, 0.001})
+    {
+        bloom_filter filter(KEYS, rate);
+        for (std::size_t i = 0; i < KEYS; ++i)
+        {
+            filter.add(key("task-", i));
+        }
+        std::size_t missed = 0;
+        for (std::size_t i = 0; i < KEYS; ++i)
+        {
+            missed += filter.maybe_contains(key("task-", i)) ? 0 : 1;
+        }
+        check("no false negatives at " + std::to_string(rate), missed == 0, std::to_string(missed) + " keys missed");
+
+        // keys that were never added: the share reported as present
+        // should be near the configured rate
+        std::size_t false_positives = 0;
+        for (std::size_t i = 0; i < PROBES; ++i)
+        {
+            false_positives += filter.maybe_contains(key("probe-", i)) ? 1 : 0;
+        }
+        double const measured = static_cast<double>(false_positives) / PROBES;
+        check("false positive rate at " + std::to_string(rate), measured > rate / 3 && measured < rate * 2,
+              "measured " + std::to_string(measured));
+    }
+
+    bloom_filter empty(0, 0.01);
+    check("empty filter", !empty.maybe_contains("anything"));
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../execution_request.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    // Decodes body and reports if the outcome is not the expected one.
+    // Each body is copied and the copy destroyed before the views are
+    // checked, so a view into freed memory shows up under ASan.
+    void check(std::string const &name, std::string const &body, bool expect_ok, std::string const &expect_error = "")
+    {
+        execution_request request;
+        std::string error;
+        bool ok;
+        {
+            std::string const copy = body;
+            ok = decode_execution_request(copy, request, error, execution_request_limits{32, 16});
+            if (ok)
+            {
+                // the task id views the body, the rest may be unescaped
+                ok = request.task_id.size() == 24 && request.task_id.data() >= copy.data() && request.task_id.data() + 24 <= copy.data() + copy.size();
+                if (!ok)
+                {
+                    error = "task_id does not view the body";
+                }
+            }
+        }
+        if (ok != expect_ok || (!expect_error.empty() && error != expect_error))
+        {
+            ++failures;
+            std::cerr << "FAIL " << name << ": " << (ok ? "accepted" : "rejected (" + error + ")") << std::endl;
+        }
+    }
+}
+
+int main()
+{
+    std::string const id = "\"task_id\": \"0123456789abcdef01234567\"";
+    check("minimal", "{" + id + ", \"script\": \"void f() {}\"}", true);
+    check("all fields", "{" + id + ", \"email\": \"a@b.c\", \"script\": \"x\", \"profile\": true}", true);
+    check("escaped script", "{" + id + ", \"script\": \"a\\nb\\u00e4\"}", true);
+
+    check("escaped task_id", "{\"task_id\": \"\\u0030123456789abcdef01234567\", \"script\": \"x\"}", false, "field \"task_id\" is not an ObjectId");
+    check("non-hex task_id", "{\"task_id\": \"0123456789abcdef0123456z\", \"script\": \"x\"}", false, "field \"task_id\" is not an ObjectId");
+    check("short task_id", "{\"task_id\": \"0123\", \"script\": \"x\"}", false, "field \"task_id\" is not an ObjectId");
+    check("long task_id", "{\"task_id\": \"0123456789abcdef012345678\", \"script\": \"x\"}", false, "field \"task_id\" is not an ObjectId");
+
+    check("duplicate field", "{" + id + ", \"script\": \"x\", \"script\": \"y\"}", false, "duplicate field \"script\"");
+    check("duplicate task_id", "{" + id + ", " + id + ", \"script\": \"x\"}", false, "duplicate field \"task_id\"");
+
+    check("oversized script", "{" + id + ", \"script\": \"" + std::string(33, 'x') + "\"}", false, "field \"script\" is too long");
+    check("oversized escaped script", "{" + id + ", \"script\": \"" + std::string(31, 'x') + "\\n\\n\"}", false, "field \"script\" is too long");
+    check("oversized email", "{" + id + ", \"email\": \"" + std::string(17, 'a') + "\", \"script\": \"x\"}", false, "field \"email\" is too long");
+    check("script at limit", "{" + id + ", \"script\": \"" + std::string(32, 'x') + "\"}", true);
+
+    check("unknown field", "{" + id + ", \"script\": \"x\", \"admin\": true}", false, "unknown field \"admin\"");
+    check("missing script", "{" + id + "}", false, "field \"script\" is missing");
+    check("missing task_id", "{\"script\": \"x\"}", false, "field \"task_id\" is missing");
+    check("trailing data", "{" + id + ", \"script\": \"x\"} {}", false, "unexpected data after the request object");
+    check("unterminated", "{" + id + ", \"script\": \"x", false, "unterminated string");
+    check("unpaired surrogate", "{" + id + ", \"script\": \"\\ud800\"}", false, "unpaired surrogate in \\u escape");
+    check("profile not boolean", "{" + id + ", \"script\": \"x\", \"profile\": 1}", false, "field \"profile\" must be true or false");
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+
+#include "../storage/indexed_task_repository.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(std::string const &name, bool ok)
+    {
+        if (!ok)
+        {
+            ++failures;
+            std::cerr << "FAIL " << name << std::endl;
+        }
+    }
+
+    // ObjectId with the given creation time; serial makes it unique
+    bsoncxx::oid make_oid(std::time_t created, std::uint32_t serial)
+    {
+        auto const t = static_cast<std::uint32_t>(created);
+        char const bytes[bsoncxx::oid::k_oid_length] = {
+            static_cast<char>(t >> 24), static_cast<char>(t >> 16), static_cast<char>(t >> 8), static_cast<char>(t),
+            0, 0, 0, 0,
+            static_cast<char>(serial >> 24), static_cast<char>(serial >> 16), static_cast<char>(serial >> 8), static_cast<char>(serial)};
+        return bsoncxx::oid(bytes, sizeof(bytes));
+    }
+
+    // Serves the tasks in ids; list() throws while down is set.
+    class fake_repository : public storage::task_repository
+    {
+    public:
+        std::vector<bsoncxx::oid> ids;
+        bool down{false};
+        int finds{0};
+
+        storage::task_ptr find(bsoncxx::oid const &) override
+        {
+            ++finds;
+            return nullptr;
+        }
+
+        std::vector<storage::task_ptr> list(storage::task_filter) override
+        {
+            if (down)
+            {
+                throw std::runtime_error("backend down");
+            }
+            std::vector<storage::task_ptr> tasks;
+            for (auto const &id : ids)
+            {
+                tasks.push_back(std::make_shared<bsoncxx::document::value const>(
+                    bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("_id", id))));
+            }
+            return tasks;
+        }
+    };
+}
+
+int main()
+{
+    // long enough for the background refresh never to run during the test
+    std::chrono::seconds const no_refresh{3600};
+    std::time_t const now = std::time(nullptr);
+    std::time_t const last_year = now - 365 * 24 * 3600;
+
+    {
+        auto backend = std::make_unique<fake_repository>();
+        fake_repository &fake = *backend;
+        for (std::uint32_t i = 0; i < 100; ++i)
+        {
+            fake.ids.push_back(make_oid(last_year, i));
+        }
+        storage::indexed_task_repository repo(std::move(backend), no_refresh);
+
+        bool all_known = true;
+        for (auto const &id : fake.ids)
+        {
+            all_known = all_known && repo.may_contain(id);
+        }
+        check("indexed ids", all_known);
+        check("unknown id from before the index", !repo.may_contain(make_oid(last_year, 1000)));
+        check("unknown id is not looked up", repo.find(make_oid(last_year, 1001)) == nullptr && fake.finds == 0);
+        check("id created after the index", repo.may_contain(make_oid(now + 1, 1002)));
+        check("id created after the index is looked up", repo.find(make_oid(now + 1, 1003)) == nullptr && fake.finds == 1);
+
+        // a failed rebuild keeps the previous index
+        fake.down = true;
+        repo.refresh();
+        check("index kept when the backend fails", repo.may_contain(fake.ids.front()) && !repo.may_contain(make_oid(last_year, 1000)));
+
+        fake.down = false;
+        fake.ids.push_back(make_oid(last_year, 1000));
+        repo.refresh();
+        check("id added by a rebuild", repo.may_contain(make_oid(last_year, 1000)));
+    }
+
+    {
+        auto backend = std::make_unique<fake_repository>();
+        backend->down = true;
+        storage::indexed_task_repository repo(std::move(backend), no_refresh);
+        check("no index yet", repo.may_contain(make_oid(last_year, 1)));
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
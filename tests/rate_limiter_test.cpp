@@ -0,0 +1,141 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../rate_limiter.hpp"
+
+namespace chrono = std::chrono;
+namespace http = boost::beast::http;
+
+namespace
+{
+    int failures = 0;
+
+    void check(std::string const &name, bool ok)
+    {
+        if (!ok)
+        {
+            ++failures;
+            std::cerr << "FAIL " << name << std::endl;
+        }
+    }
+
+    bool parses(std::string const &spec, double rate, double burst)
+    {
+        rate_limit const limit = parse_rate_limit(spec);
+        return limit.rate == rate && limit.burst == burst;
+    }
+
+    bool rejected(std::string const &spec)
+    {
+        try
+        {
+            parse_rate_limit(spec);
+        }
+        catch (std::invalid_argument const &)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    // requests admitted out of n, all at the same instant
+    int admitted(rate_limiter &limiter, std::string const &key, int n, chrono::steady_clock::time_point now)
+    {
+        int ok = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            ok += limiter.acquire(key, now) ? 0 : 1;
+        }
+        return ok;
+    }
+}
+
+int main()
+{
+    check("rate and burst", parses("0.5:10", 0.5, 10));
+    check("burst defaults to the rate", parses("3", 3, 3));
+    check("burst is at least one", parses("0.5", 0.5, 1));
+    for (char const *spec : {"", "x", "1:", ":2", "1:2x", "1;2", "0", "-1", "1:0.5", "nan"})
+    {
+        check("rejects \"" + std::string(spec) + "\"", rejected(spec));
+    }
+
+    auto const t0 = chrono::steady_clock::now();
+    {
+        rate_limiter limiter(rate_limit{2, 5});
+        check("burst", admitted(limiter, "a", 10, t0) == 5);
+        auto const retry_after = limiter.acquire("a", t0);
+        check("retry after", retry_after && *retry_after == chrono::seconds(1));
+        check("keys are independent", admitted(limiter, "b", 1, t0) == 1);
+        check("refill", admitted(limiter, "a", 10, t0 + chrono::seconds(1)) == 2);
+        check("refill up to the burst", admitted(limiter, "a", 10, t0 + chrono::hours(1)) == 5);
+    }
+    {
+        // idle buckets are swept while their shard is in use
+        rate_limiter limiter(rate_limit{1, 1});
+        for (int i = 0; i < 5000; ++i)
+        {
+            limiter.acquire("k" + std::to_string(i), t0);
+        }
+        check("one bucket per key", limiter.size() == 5000);
+        for (int i = 0; i < 70000; ++i)
+        {
+            limiter.acquire("z" + std::to_string(i % 64), t0 + chrono::seconds(10));
+        }
+        check("idle buckets swept", limiter.size() < 5000);
+    }
+    {
+        request_limiter limiter;
+        check("no rules", limiter.empty() && !limiter.admit(http::verb::post, "/execute", "10.0.0.1"));
+        limiter.add_rule("POST /execute=1:2");
+        int rejections = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            rejections += limiter.admit(http::verb::post, "/execute", "10.0.0.1") ? 1 : 0;
+        }
+        check("rule applies", rejections == 3);
+        check("other method", !limiter.admit(http::verb::get, "/execute", "10.0.0.1"));
+        check("other path", !limiter.admit(http::verb::post, "/compile", "10.0.0.1"));
+        check("other client", !limiter.admit(http::verb::post, "/execute", "10.0.0.2"));
+        bool malformed = true;
+        for (char const *spec : {"/execute", "=1", "FETCH /x=1", "/[=1", "/x=0"})
+        {
+            try
+            {
+                limiter.add_rule(spec);
+                malformed = false;
+            }
+            catch (std::invalid_argument const &)
+            {
+            }
+        }
+        check("malformed rules", malformed);
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
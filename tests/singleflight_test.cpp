@@ -0,0 +1,128 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../singleflight.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(std::string const &name, bool ok)
+    {
+        if (!ok)
+        {
+            ++failures;
+            std::cerr << "FAIL " << name << std::endl;
+        }
+    }
+
+    constexpr int FOLLOWERS = 16;
+
+    // Starts a call for key that blocks until release is set, lets
+    // FOLLOWERS more callers join it, then releases it. Returns the number
+    // of callers that got result() and the number told they shared it.
+    template <typename Fn>
+    std::pair<int, int> coalesce(singleflight<std::string, int> &flight, std::string const &key, std::atomic<int> &runs, Fn result)
+    {
+        std::promise<void> started;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::atomic<int> answered{0};
+        std::atomic<int> shared{0};
+        auto const call = [&]
+        {
+            bool was_shared = false;
+            try
+            {
+                flight.run(key, [&]
+                           {
+                               ++runs;
+                               started.set_value();
+                               released.wait();
+                               return result(); }, &was_shared);
+                ++answered;
+            }
+            catch (std::runtime_error const &)
+            {
+                ++answered;
+            }
+            shared += was_shared ? 1 : 0;
+        };
+        std::thread leader(call);
+        started.get_future().wait();
+        std::vector<std::thread> followers;
+        for (int i = 0; i < FOLLOWERS; ++i)
+        {
+            followers.emplace_back(call);
+        }
+        // give the followers time to find the pending call
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        release.set_value();
+        leader.join();
+        for (auto &t : followers)
+        {
+            t.join();
+        }
+        return {answered.load(), shared.load()};
+    }
+}
+
+int main()
+{
+    singleflight<std::string, int> flight;
+    std::atomic<int> runs{0};
+
+    auto const [answered, shared] = coalesce(flight, "task", runs, []
+                                             { return 42; });
+    check("one run for concurrent callers", runs == 1);
+    check("every caller answered", answered == FOLLOWERS + 1);
+    check("followers share the result", shared == FOLLOWERS);
+
+    int const again = flight.run("task", [&]
+                                 { ++runs; return 7; });
+    check("nothing cached after the call", runs == 2 && again == 7);
+
+    runs = 0;
+    auto const [failed, shared_failures] = coalesce(flight, "broken", runs, []() -> int
+                                                    { throw std::runtime_error("backend down"); });
+    check("one run for a failing call", runs == 1);
+    check("every caller gets the exception", failed == FOLLOWERS + 1 && shared_failures == FOLLOWERS);
+    check("a failure is not remembered", flight.run("broken", []
+                                                   { return 1; }) == 1);
+
+    bool was_shared = true;
+    check("separate keys", flight.run("other", []
+                                      { return 3; }, &was_shared) == 3 && !was_shared);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# Compares the epoll and io_uring builds on the same workload: builds the
+# server twice, starts each build on the given tasks and replays the same
+# capture against it, e.g.
+#
+#   tools/bench-io.sh capture.bin tasks.json 4 3
+#
+# replays capture.bin at 4x its recorded rate, three rounds per backend,
+# alternating the backends so that drift on the machine hits both alike.
+# Record a capture first with `script-webservice --capture-file`.
+# Reports go to bench-io/<backend>-<round>.txt; a summary of the overall
+# latency lines is printed at the end.
+
+set -euo pipefail
+
+CAPTURE=${1:?capture file}
+TASKS=${2:?task export (JSON or BSON)}
+SPEED=${3:-1}
+ROUNDS=${4:-3}
+PORT=31400
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+OUT=bench-io
+
+mkdir -p "$OUT"
+for backend in epoll io_uring; do
+  flag=OFF
+  [[ $backend == io_uring ]] && flag=ON
+  cmake -S "$SRC" -B "build-$backend" -DCMAKE_BUILD_TYPE=Release -DWITH_IO_URING=$flag >/dev/null
+  cmake --build "build-$backend" -j"$(nproc)" >/dev/null
+done
+
+pid=
+trap '[[ -n $pid ]] && kill "$pid" 2>/dev/null; wait' EXIT INT TERM
+
+for ((round = 1; round <= ROUNDS; ++round)); do
+  for backend in epoll io_uring; do
+    "build-$backend/script-webservice" --host 127.0.0.1 --port "$PORT" \
+      --storage memory --task-file "$TASKS" --journal false \
+      --rate-limit "" --email-limit "" >/dev/null &
+    pid=$!
+    # wait for the listener
+    until (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; do sleep 0.1; done
+    "build-$backend/replay" "$CAPTURE" 127.0.0.1 "$PORT" --speed "$SPEED" \
+      >"$OUT/$backend-$round.txt" || true
+    kill "$pid"
+    wait "$pid" || true
+    pid=
+  done
+done
+
+for backend in epoll io_uring; do
+  echo "== $backend"
+  grep -h -e " requests in " -e "^all (replay)" "$OUT/$backend"-*.txt
+done
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+# Starts N graders and a front node on localhost, all serving the tasks
+# from one export file, e.g.
+#
+#   tools/local-graders.sh ./build/script-webservice tasks.json 3
+#
+# The front node listens on port 31337; graders on 4101, 4102, ...
+# Ctrl-C stops all of them.
+
+set -euo pipefail
+
+BIN=${1:?path to script-webservice}
+TASKS=${2:?task export (JSON or BSON)}
+N=${3:-3}
+BASE_PORT=4101
+
+pids=()
+trap 'kill "${pids[@]}" 2>/dev/null; wait' EXIT INT TERM
+
+graders=()
+for ((i = 0; i < N; ++i)); do
+  port=$((BASE_PORT + i))
+  "$BIN" --host 127.0.0.1 --storage memory --task-file "$TASKS" --grader-port "$port" --grader-executors 2 &
+  pids+=($!)
+  graders+=("127.0.0.1:$port")
+done
+
+"$BIN" --host 127.0.0.1 --port 31337 --storage memory --task-file "$TASKS" --journal false \
+  --graders "$(IFS=,; echo "${graders[*]}")" &
+pids+=($!)
+
+wait
@@ -0,0 +1,329 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/program_options.hpp>
+
+#include "../traffic_capture.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace po = boost::program_options;
+namespace chrono = std::chrono;
+using tcp = net::ip::tcp;
+
+struct replay_result
+{
+  std::string route;
+  unsigned int status;
+  bool failed;
+  chrono::steady_clock::duration latency;
+  std::uint32_t original_service_usecs;
+};
+
+// Collapses ObjectIds so that e.g. all /find/task/<id> requests are reported together.
+std::string route_of(std::string const &target)
+{
+  static std::regex const oid_re("[0-9a-f]{24}");
+  return std::regex_replace(target.substr(0, target.find('?')), oid_re, "{id}");
+}
+
+class replay_session : public std::enable_shared_from_this<replay_session>
+{
+public:
+  typedef std::function<void(replay_result)> done_callback_t;
+
+  replay_session(net::io_context &ioc, captured_request const &request, std::string const &host, done_callback_t done)
+      : stream_(ioc)
+      , done_(std::move(done))
+      , route_(route_of(request.target))
+      , original_service_usecs_(request.header.service_usecs)
+  {
+    req_.method(static_cast<http::verb>(request.header.method));
+    req_.target(request.target);
+    req_.set(http::field::host, host);
+    req_.set(http::field::user_agent, "script-webservice-replay");
+    if (!request.body.empty())
+    {
+      req_.set(http::field::content_type, "application/json");
+    }
+    req_.body() = request.body;
+    req_.prepare_payload();
+  }
+
+  // Latency is measured from the scheduled send time, so a server that
+  // falls behind is charged for the queueing it causes.
+  void run(tcp::resolver::results_type const &endpoints, chrono::steady_clock::time_point scheduled)
+  {
+    scheduled_ = scheduled;
+    stream_.expires_after(chrono::seconds(30));
+    stream_.async_connect(
+        endpoints,
+        [self = shared_from_this()](beast::error_code ec, tcp::endpoint const &)
+        {
+          if (ec)
+          {
+            return self->finish(true);
+          }
+          http::async_write(
+              self->stream_, self->req_,
+              [self](beast::error_code ec, std::size_t)
+              {
+                if (ec)
+                {
+                  return self->finish(true);
+                }
+                http::async_read(
+                    self->stream_, self->buffer_, self->res_,
+                    [self](beast::error_code ec, std::size_t)
+                    {
+                      self->finish(static_cast<bool>(ec));
+                    });
+              });
+        });
+  }
+
+private:
+  beast::tcp_stream stream_;
+  beast::flat_buffer buffer_;
+  http::request<http::string_body> req_;
+  http::response<http::string_body> res_;
+  done_callback_t done_;
+  std::string route_;
+  std::uint32_t original_service_usecs_;
+  chrono::steady_clock::time_point scheduled_;
+
+  void finish(bool failed)
+  {
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+    done_(replay_result{route_, res_.result_int(), failed, chrono::steady_clock::now() - scheduled_, original_service_usecs_});
+  }
+};
+
+double percentile(std::vector<double> &values, double p)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+  std::size_t const idx = std::min(values.size() - 1, static_cast<std::size_t>(p * static_cast<double>(values.size())));
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(idx), values.end());
+  return values[idx];
+}
+
+void print_distribution(std::string const &label, std::vector<double> values)
+{
+  std::cout << std::left << std::setw(28) << label << std::right
+            << std::setw(8) << values.size()
+            << std::fixed << std::setprecision(2)
+            << std::setw(10) << percentile(values, 0.5)
+            << std::setw(10) << percentile(values, 0.9)
+            << std::setw(10) << percentile(values, 0.99)
+            << std::setw(10) << percentile(values, 0.999)
+            << std::setw(10) << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()))
+            << std::endl;
+}
+
+int main(int argc, const char *argv[])
+{
+  std::string capture_file;
+  std::string host;
+  std::string port;
+  double speed;
+  unsigned int num_threads;
+
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "show this help")
+    ("capture", po::value<std::string>(&capture_file)->required(), "capture file written by `script-webservice --capture-file`")
+    ("host", po::value<std::string>(&host)->default_value("127.0.0.1"), "server to replay against")
+    ("port", po::value<std::string>(&port)->default_value("31337"), "port of the server")
+    ("speed", po::value<double>(&speed)->default_value(1.0), "replay rate relative to the captured traffic, e.g. 2 for twice as fast")
+    ("threads", po::value<unsigned int>(&num_threads)->default_value(std::thread::hardware_concurrency()), "number of I/O threads");
+  po::positional_options_description positional;
+  positional.add("capture", 1).add("host", 1).add("port", 1);
+
+  try
+  {
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    if (vm.count("help"))
+    {
+      std::cout << "Usage:" << std::endl
+                << "  replay <capture> [<host> <port>] [options]" << std::endl
+                << std::endl
+                << "Sends the captured requests open-loop at their original pace (scaled by" << std::endl
+                << "--speed) and reports throughput and latency. For comparable runs, start" << std::endl
+                << "the server with `--storage memory --task-file <export>` and --journal false." << std::endl
+                << std::endl
+                << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+    if (speed <= 0.0)
+    {
+      throw std::invalid_argument("--speed must be positive");
+    }
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<captured_request> requests;
+  try
+  {
+    requests = read_capture(capture_file);
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (requests.empty())
+  {
+    std::cerr << capture_file << " contains no requests." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  net::io_context ioc;
+  tcp::resolver::results_type endpoints;
+  try
+  {
+    endpoints = tcp::resolver(ioc).resolve(host, port);
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "Cannot resolve " << host << ':' << port << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::mutex results_mtx;
+  std::vector<replay_result> results;
+  results.reserve(requests.size());
+  auto const on_done = [&results_mtx, &results](replay_result result)
+  {
+    std::lock_guard<std::mutex> lock(results_mtx);
+    results.push_back(std::move(result));
+  };
+
+  // Launches one request after the other when its time has come; the
+  // timer never waits for responses.
+  auto const first_arrival = requests.front().header.arrival_usecs;
+  auto const start = chrono::steady_clock::now();
+  net::steady_timer timer(ioc);
+  std::size_t next = 0;
+  std::function<void()> schedule = [&]
+  {
+    if (next == requests.size())
+    {
+      return;
+    }
+    auto const offset = chrono::duration<double, std::micro>(static_cast<double>(requests[next].header.arrival_usecs - first_arrival) / speed);
+    auto const due = start + chrono::duration_cast<chrono::steady_clock::duration>(offset);
+    timer.expires_at(due);
+    timer.async_wait(
+        [&, due](beast::error_code ec)
+        {
+          if (ec)
+          {
+            return;
+          }
+          std::make_shared<replay_session>(ioc, requests[next], host, on_done)->run(endpoints, due);
+          ++next;
+          schedule();
+        });
+  };
+  schedule();
+
+  std::vector<std::thread> threads;
+  for (auto i = 1U; i < std::max(1U, num_threads); ++i)
+  {
+    threads.emplace_back([&ioc] { ioc.run(); });
+  }
+  ioc.run();
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+  auto const wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  std::size_t failed = 0;
+  std::map<unsigned int, std::size_t> status_counts;
+  std::vector<double> latencies;
+  std::vector<double> original;
+  std::map<std::string, std::vector<double>> route_latencies;
+  for (auto const &result : results)
+  {
+    if (result.failed)
+    {
+      ++failed;
+      continue;
+    }
+    ++status_counts[result.status];
+    double const msecs = chrono::duration<double, std::milli>(result.latency).count();
+    latencies.push_back(msecs);
+    original.push_back(1e-3 * result.original_service_usecs);
+    route_latencies[result.route].push_back(msecs);
+  }
+
+  std::cout << results.size() << " requests in " << std::fixed << std::setprecision(2) << wall << " s ("
+            << static_cast<double>(results.size()) / wall << " req/s), "
+            << failed << " failed" << std::endl;
+  for (auto const &[status, count] : status_counts)
+  {
+    std::cout << "  HTTP " << status << ": " << count << std::endl;
+  }
+  std::cout << std::endl
+            << std::left << std::setw(28) << "latency [ms]" << std::right
+            << std::setw(8) << "count"
+            << std::setw(10) << "p50"
+            << std::setw(10) << "p90"
+            << std::setw(10) << "p99"
+            << std::setw(10) << "p99.9"
+            << std::setw(10) << "max" << std::endl;
+  print_distribution("all (replay)", latencies);
+  print_distribution("all (captured service time)", original);
+  for (auto &[route, values] : route_latencies)
+  {
+    print_distribution(route, values);
+  }
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
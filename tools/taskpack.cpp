@@ -0,0 +1,48 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+#include "../storage/task_import.hpp"
+#include "../storage/task_pack.hpp"
+
+int main(int argc, const char *argv[])
+{
+  if (argc != 3)
+  {
+    std::cout << "Usage:" << std::endl
+              << "  taskpack <export.json|export.bson> <tasks.pack>" << std::endl
+              << std::endl
+              << "Converts a mongoexport (JSON) or mongodump (BSON) file of the task" << std::endl
+              << "collection into a task pack for `script-webservice --storage taskpack`." << std::endl;
+    return EXIT_FAILURE;
+  }
+  try
+  {
+    auto const tasks = storage::read_task_export(argv[1]);
+    storage::write_task_pack(argv[2], tasks);
+    std::cout << tasks.size() << " tasks written to " << argv[2] << std::endl;
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "Conversion failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
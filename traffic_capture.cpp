@@ -0,0 +1,210 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "traffic_capture.hpp"
+#include "helper.hpp"
+
+namespace chrono = std::chrono;
+
+namespace
+{
+    bool is_local_part_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || std::strchr(".!#$%&'*+/=?^_`{|}~-", c) != nullptr;
+    }
+
+    bool is_domain_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-';
+    }
+
+    std::uint64_t rotl(std::uint64_t x, int b)
+    {
+        return (x << b) | (x >> (64 - b));
+    }
+
+    // SipHash-2-4 (Aumasson and Bernstein), a keyed hash for short inputs.
+    std::uint64_t siphash(std::string_view data, redaction_key const &key)
+    {
+        std::uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+        std::uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+        std::uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+        std::uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+        auto const round = [&]
+        {
+            v0 += v1;
+            v1 = rotl(v1, 13) ^ v0;
+            v0 = rotl(v0, 32);
+            v2 += v3;
+            v3 = rotl(v3, 16) ^ v2;
+            v0 += v3;
+            v3 = rotl(v3, 21) ^ v0;
+            v2 += v1;
+            v1 = rotl(v1, 17) ^ v2;
+            v2 = rotl(v2, 32);
+        };
+        std::size_t const full = data.size() / 8 * 8;
+        for (std::size_t i = 0; i < full; i += 8)
+        {
+            std::uint64_t m = 0;
+            for (int j = 7; j >= 0; --j)
+            {
+                m = (m << 8) | static_cast<unsigned char>(data[i + static_cast<std::size_t>(j)]);
+            }
+            v3 ^= m;
+            round();
+            round();
+            v0 ^= m;
+        }
+        std::uint64_t last = static_cast<std::uint64_t>(data.size() & 0xff) << 56;
+        for (std::size_t j = data.size() - full; j > 0; --j)
+        {
+            last |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[full + j - 1])) << (8 * (j - 1));
+        }
+        v3 ^= last;
+        round();
+        round();
+        v0 ^= last;
+        v2 ^= 0xff;
+        round();
+        round();
+        round();
+        round();
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+}
+
+std::string redact_emails(std::string_view text, redaction_key const &key)
+{
+    std::string result;
+    result.reserve(text.size());
+    std::size_t copied = 0;
+    std::size_t at = text.find('@');
+    while (at != std::string_view::npos)
+    {
+        std::size_t begin = at;
+        while (begin > copied && is_local_part_char(text[begin - 1]))
+        {
+            --begin;
+        }
+        std::size_t end = at + 1;
+        while (end < text.size() && is_domain_char(text[end]))
+        {
+            ++end;
+        }
+        std::string_view const domain = text.substr(at + 1, end - at - 1);
+        if (begin < at && domain.find('.') != std::string_view::npos)
+        {
+            result.append(text.substr(copied, begin - copied));
+            result += 'u';
+            result += to_hex(siphash(text.substr(begin, end - begin), key));
+            result += "@example.invalid";
+            copied = end;
+        }
+        at = text.find('@', at + 1);
+    }
+    result.append(text.substr(copied));
+    return result;
+}
+
+traffic_capture::traffic_capture(std::string const &path)
+    : out_(path, std::ios::binary | std::ios::trunc)
+    , start_(chrono::steady_clock::now())
+{
+    std::random_device random;
+    for (auto &k : key_)
+    {
+        k = (static_cast<std::uint64_t>(random()) << 32) | random();
+    }
+    if (!out_)
+    {
+        throw std::runtime_error("cannot create " + path);
+    }
+    capture_file_header header{};
+    std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    out_.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out_.flush();
+}
+
+void traffic_capture::record(chrono::steady_clock::time_point arrival,
+                             chrono::steady_clock::duration service_time,
+                             std::uint16_t method,
+                             std::uint16_t status,
+                             std::string_view target,
+                             std::string_view body)
+{
+    std::string const redacted_target = redact_emails(target.substr(0, std::numeric_limits<std::uint16_t>::max()), key_);
+    std::string const redacted_body = redact_emails(body, key_);
+    capture_record_header header{};
+    header.arrival_usecs = static_cast<std::uint64_t>(std::max<chrono::microseconds::rep>(0, chrono::duration_cast<chrono::microseconds>(arrival - start_).count()));
+    header.service_usecs = static_cast<std::uint32_t>(std::min<chrono::microseconds::rep>(
+        std::numeric_limits<std::uint32_t>::max(),
+        chrono::duration_cast<chrono::microseconds>(service_time).count()));
+    header.body_length = static_cast<std::uint32_t>(redacted_body.size());
+    header.target_length = static_cast<std::uint16_t>(std::min<std::size_t>(redacted_target.size(), std::numeric_limits<std::uint16_t>::max()));
+    header.method = method;
+    header.status = status;
+    std::lock_guard<std::mutex> lock(mtx_);
+    out_.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out_.write(redacted_target.data(), header.target_length);
+    out_.write(redacted_body.data(), static_cast<std::streamsize>(redacted_body.size()));
+    out_.flush();
+}
+
+std::vector<captured_request> read_capture(std::string const &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    capture_file_header file_header{};
+    if (!in.read(reinterpret_cast<char *>(&file_header), sizeof(file_header)) ||
+        std::memcmp(file_header.magic, CAPTURE_MAGIC, sizeof(file_header.magic)) != 0 ||
+        file_header.version != CAPTURE_VERSION)
+    {
+        throw std::runtime_error(path + " is not a capture file");
+    }
+    std::vector<captured_request> requests;
+    captured_request request{};
+    while (in.read(reinterpret_cast<char *>(&request.header), sizeof(request.header)))
+    {
+        request.target.resize(request.header.target_length);
+        request.body.resize(request.header.body_length);
+        if (!in.read(request.target.data(), static_cast<std::streamsize>(request.target.size())) ||
+            !in.read(request.body.data(), static_cast<std::streamsize>(request.body.size())))
+        {
+            // a server killed in the middle of a write leaves a truncated record
+            break;
+        }
+        requests.push_back(std::move(request));
+    }
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](captured_request const &a, captured_request const &b)
+                     {
+                         return a.header.arrival_usecs < b.header.arrival_usecs;
+                     });
+    return requests;
+}
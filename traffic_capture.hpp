@@ -0,0 +1,103 @@
+/*
+ Copyright © 2023 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG - Redaktion c't
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRAFFIC_CAPTURE_HPP__
+#define __TRAFFIC_CAPTURE_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A capture file holds the requests a server received, in the order
+// their responses were sent:
+//
+//   capture_file_header | (capture_record_header | target | body)*
+//
+// All integers are little-endian. Email addresses in targets and bodies
+// are replaced by stable pseudonyms before they are written.
+struct capture_file_header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+};
+
+struct capture_record_header
+{
+    std::uint64_t arrival_usecs;   // since the capture was started
+    std::uint32_t service_usecs;   // from the end of the read to the end of the write
+    std::uint32_t body_length;
+    std::uint16_t target_length;
+    std::uint16_t method;          // boost::beast::http::verb
+    std::uint16_t status;
+    std::uint16_t reserved;
+};
+
+static_assert(sizeof(capture_file_header) == 16);
+static_assert(sizeof(capture_record_header) == 24);
+
+constexpr char CAPTURE_MAGIC[8] = {'A', 'N', 'G', 'L', 'C', 'A', 'P', 'T'};
+constexpr std::uint32_t CAPTURE_VERSION = 1;
+
+struct captured_request
+{
+    capture_record_header header;
+    std::string target;
+    std::string body;
+};
+
+// Secret key for the pseudonyms of one capture file.
+typedef std::array<std::uint64_t, 2> redaction_key;
+
+// Replaces every email address with `u<hash>@example.invalid`, so that a
+// replay still sees as many distinct submitters as the original traffic.
+// The hash is keyed (SipHash-2-4): without the key, which is never
+// written out, a guessed address cannot be checked against a capture.
+extern std::string redact_emails(std::string_view text, redaction_key const &key);
+
+class traffic_capture
+{
+public:
+    // Throws std::runtime_error if the file cannot be created.
+    explicit traffic_capture(std::string const &path);
+    traffic_capture(traffic_capture const &) = delete;
+    traffic_capture &operator=(traffic_capture const &) = delete;
+
+    void record(std::chrono::steady_clock::time_point arrival,
+                std::chrono::steady_clock::duration service_time,
+                std::uint16_t method,
+                std::uint16_t status,
+                std::string_view target,
+                std::string_view body);
+
+private:
+    std::mutex mtx_;
+    std::ofstream out_;
+    std::chrono::steady_clock::time_point start_;
+    redaction_key key_;
+};
+
+// Reads all requests of a capture file, sorted by arrival. Throws
+// std::runtime_error if the file is missing or malformed.
+extern std::vector<captured_request> read_capture(std::string const &path);
+
+#endif // __TRAFFIC_CAPTURE_HPP__
@@ -19,6 +19,8 @@
 #define __TRIP_RESPONSE_REQUEST_HPP__
 
 #include <string>
+#include <utility>
+#include <vector>
 #include <boost/beast/http.hpp>
 
 namespace trip
@@ -30,6 +32,8 @@ namespace trip
         http::status status;
         std::string body;
         std::string mime_type = "application/json";
+        bool cacheable = false;
+        std::vector<std::pair<http::field, std::string>> headers{};
     };
 
     typedef http::request<http::string_body> request;